@@ -1,33 +1,53 @@
 #include <stdio.h>
 #include "config.h"
 #include "ini.h"
+#include "profile.h"
 
 struct settingkey_t settings[NUM_CONFIGVARS] =
 {
-    {"KEY_FULLSCREEN", 0},
-    {"KEY_UPSCALING", 0},
-    {"KEY_SCREEN_WIDTH", 640},
-    {"KEY_SCREEN_HEIGHT", 480},
-    {"KEY_SSREADBACKS", 0},
-    {"KEY_SSDITHER", 0},
-    {"KEY_DEINTERLACE", 0},
-    {"KEY_INTEGER", 0},
-    {"KEY_OVERSCANCROP", 0},
-    {"KEY_AA", 0},
-    {"KEY_DIVOT", 1},
-    {"KEY_GAMMADITHER", 1},
-    {"KEY_VIBILERP", 1},
-    {"KEY_VIDITHER", 1},
-    {"KEY_NATIVETEXTLOD", 0},
-    {"KEY_NATIVETEXTRECT", 1},
-    {"KEY_VSYNC", 1},
-    {"KEY_DOWNSCALE", 1},
-    {"KEY_WIDESCREEN", 0},
-    {"KEY_SYNCHRONOUS", 1}
+    {"KEY_FULLSCREEN", 0, CONFIG_RELOAD_DEVICE},
+    {"KEY_UPSCALING", 0, CONFIG_RELOAD_FRONTEND},
+    {"KEY_SCREEN_WIDTH", 640, CONFIG_RELOAD_DEVICE},
+    {"KEY_SCREEN_HEIGHT", 480, CONFIG_RELOAD_DEVICE},
+    {"KEY_SSREADBACKS", 0, CONFIG_RELOAD_FRONTEND},
+    {"KEY_SSDITHER", 0, CONFIG_RELOAD_FRONTEND},
+    {"KEY_DEINTERLACE", 0, CONFIG_RELOAD_SCANOUT},
+    {"KEY_INTEGER", 0, CONFIG_RELOAD_SCANOUT},
+    {"KEY_OVERSCANCROP", 0, CONFIG_RELOAD_SCANOUT},
+    {"KEY_AA", 0, CONFIG_RELOAD_SCANOUT},
+    {"KEY_DIVOT", 1, CONFIG_RELOAD_SCANOUT},
+    {"KEY_GAMMADITHER", 1, CONFIG_RELOAD_SCANOUT},
+    {"KEY_VIBILERP", 1, CONFIG_RELOAD_SCANOUT},
+    {"KEY_VIDITHER", 1, CONFIG_RELOAD_SCANOUT},
+    {"KEY_NATIVETEXTLOD", 0, CONFIG_RELOAD_SCANOUT},
+    {"KEY_NATIVETEXTRECT", 1, CONFIG_RELOAD_SCANOUT},
+    {"KEY_VSYNC", 1, CONFIG_RELOAD_SWAPCHAIN},
+    {"KEY_DOWNSCALE", 1, CONFIG_RELOAD_SCANOUT},
+    {"KEY_WIDESCREEN", 0, CONFIG_RELOAD_SCANOUT},
+    {"KEY_SYNCHRONOUS", 1, CONFIG_RELOAD_SCANOUT},
+    {"KEY_AUTOSCALE", 0, CONFIG_RELOAD_FRONTEND},
+    {"KEY_SWAPCHAIN_IMAGES", 0, CONFIG_RELOAD_DEVICE},
+    {"KEY_AFFINITY_EXECUTOR", 0, CONFIG_RELOAD_THREADS},
+    {"KEY_AFFINITY_MAILBOX", 0, CONFIG_RELOAD_THREADS},
+    {"KEY_AFFINITY_WORKER", 0, CONFIG_RELOAD_THREADS},
+    {"KEY_PRIORITY_EXECUTOR", 0, CONFIG_RELOAD_THREADS},
+    {"KEY_PRIORITY_MAILBOX", 0, CONFIG_RELOAD_THREADS},
+    {"KEY_PERF_HUD", 0, CONFIG_RELOAD_SCANOUT}
 };
 
+// Values from the table above, for keys cfg.ini does not have.
+static int defaults[NUM_CONFIGVARS];
+static bool defaults_saved;
+
 void config_init()
 {
+	if (!defaults_saved)
+	{
+		for (int i = 0; i < NUM_CONFIGVARS; i++)
+			defaults[i] = settings[i].val;
+		defaults_saved = true;
+	}
+
 	// initialize ini parser
 	ini_init();
 
@@ -47,8 +67,13 @@ void config_save()
 {
 	for (int i = 0; i < NUM_CONFIGVARS; i++) 
     {
-        ini_set_value(settings[i].name, settings[i].val);
+        // Keys the open ROM overrides stay with its profile.
+        if (profile_overrides(settings[i].name))
+            ini_set_section_value(profile_section(), settings[i].name, settings[i].val);
+        else
+            ini_set_value(settings[i].name, settings[i].val);
     }
+    ini_flush();
 }
 
 void config_load()
@@ -57,10 +82,39 @@ void config_load()
     {
         int value = -1;
         bool ret = ini_get_value(settings[i].name, &value);
-        if (ret)
-        {
-            settings[i].val = value;
-        }
+        // Start from the defaults so a closed profile leaves nothing behind.
+        settings[i].val = ret ? value : defaults[i];
     }
+    profile_apply();
 }
 
+
+unsigned config_diff(const int applied[NUM_CONFIGVARS])
+{
+	unsigned reload = 0;
+	for (int i = 0; i < NUM_CONFIGVARS; i++)
+	{
+		if (settings[i].val != applied[i])
+			reload |= CONFIG_RELOAD_BIT(settings[i].reload);
+	}
+	return reload;
+}
+
+const char* config_reload_name(enum config_reload reload)
+{
+	switch (reload)
+	{
+	case CONFIG_RELOAD_SCANOUT:
+		return "scanout";
+	case CONFIG_RELOAD_THREADS:
+		return "thread placement";
+	case CONFIG_RELOAD_SWAPCHAIN:
+		return "swapchain";
+	case CONFIG_RELOAD_FRONTEND:
+		return "rdp frontend";
+	case CONFIG_RELOAD_DEVICE:
+		return "device";
+	default:
+		return "unknown";
+	}
+}
@@ -21,12 +21,35 @@
 #define KEY_DOWNSCALING 17
 #define KEY_WIDESCREEN 18
 #define KEY_SYNCHRONOUS 19
-#define NUM_CONFIGVARS 20
+#define KEY_AUTOSCALE 20
+#define KEY_SWAPCHAIN_IMAGES 21
+// CPU masks and priority levels for plugin threads, see thread_policy.h.
+#define KEY_AFFINITY_EXECUTOR 22
+#define KEY_AFFINITY_MAILBOX 23
+#define KEY_AFFINITY_WORKER 24
+#define KEY_PRIORITY_EXECUTOR 25
+#define KEY_PRIORITY_MAILBOX 26
+#define KEY_PERF_HUD 27
+#define NUM_CONFIGVARS 28
+
+// What has to be rebuilt for a changed key to take effect, cheapest first.
+enum config_reload
+{
+	CONFIG_RELOAD_SCANOUT,   // read every frame: VI options, quirks and presentation
+	CONFIG_RELOAD_THREADS,   // thread placement, re-applied to the executor in place
+	CONFIG_RELOAD_SWAPCHAIN, // new swapchain on the existing device
+	CONFIG_RELOAD_FRONTEND,  // new RDP CommandProcessor on the existing device
+	CONFIG_RELOAD_DEVICE,    // full retro_deinit/retro_init
+	CONFIG_RELOAD_COUNT
+};
+
+#define CONFIG_RELOAD_BIT(reload) (1u << (reload))
 
 struct settingkey_t
 {
 	char name[255];
 	int val;
+	enum config_reload reload;
 };
 
 #ifdef __cplusplus
@@ -39,6 +62,10 @@ extern "C" {
 	extern void config_save(void);
 	extern void config_load(void);
 
+	// Returns a CONFIG_RELOAD_BIT mask of the classes whose keys differ from applied.
+	extern unsigned config_diff(const int applied[NUM_CONFIGVARS]);
+	extern const char* config_reload_name(enum config_reload reload);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,155 @@
+#include "fb_tracker.h"
+
+#include <algorithm>
+
+// RDP opcodes, see the command list in the RDP programming manual.
+enum : uint32_t {
+    kOpTriangleFirst = 0x08,
+    kOpTriangleLast = 0x0f,
+    kOpTextureRectangle = 0x24,
+    kOpTextureRectangleFlip = 0x25,
+    kOpSetScissor = 0x2d,
+    kOpSetOtherModes = 0x2f,
+    kOpFillRectangle = 0x36,
+    kOpSetMaskImage = 0x3e,
+    kOpSetColorImage = 0x3f,
+};
+
+static const uint32_t kZUpdateEnable = 1u << 5;
+static const uint32_t kAddressMask = 0x00ffffff;
+// Until a scissor arrives, assume a full NTSC field.
+static const uint32_t kDefaultHeight = 240;
+
+static uint32_t image_bytes(const FramebufferTracker::Image& image) {
+    // 4-bit color images are packed two pixels to a byte.
+    uint32_t row = image.size ? image.width * image.size : (image.width + 1) / 2;
+    return row * image.height;
+}
+
+void FramebufferTracker::reset(uint32_t rdram_size) {
+    pages_.assign((rdram_size + (1u << kPageShift) - 1) >> kPageShift, 0);
+    unsignalled_.clear();
+    completed_ = 0;
+    marked_ = false;
+}
+
+void FramebufferTracker::command(const uint32_t* words) {
+    const uint32_t w0 = words[0];
+    const uint32_t w1 = words[1];
+    const uint32_t op = (w0 >> 24) & 63;
+
+    switch (op) {
+    case kOpSetColorImage:
+        color_.addr = w1 & kAddressMask;
+        color_.size = (1u << ((w0 >> 19) & 3)) >> 1;
+        color_.width = (w0 & 0x3ff) + 1;
+        marked_ = false;
+        break;
+
+    case kOpSetMaskImage:
+        depth_.addr = w1 & kAddressMask;
+        marked_ = false;
+        break;
+
+    case kOpSetScissor:
+        // Lower right Y in 10.2 fixed point.
+        color_.height = ((w1 & 0xfff) + 3) >> 2;
+        marked_ = false;
+        break;
+
+    case kOpSetOtherModes:
+        if (depth_update_ != !!(w1 & kZUpdateEnable))
+            marked_ = false;
+        depth_update_ = !!(w1 & kZUpdateEnable);
+        break;
+
+    case kOpTextureRectangle:
+    case kOpTextureRectangleFlip:
+    case kOpFillRectangle:
+        mark_color();
+        break;
+
+    default:
+        if (op >= kOpTriangleFirst && op <= kOpTriangleLast)
+            mark_color();
+        break;
+    }
+}
+
+void FramebufferTracker::mark_color() {
+    if (marked_)
+        return;
+    marked_ = true;
+
+    Image color = color_;
+    if (!color.height)
+        color.height = kDefaultHeight;
+    mark(color.addr, image_bytes(color));
+    use_image(color);
+
+    if (depth_update_) {
+        depth_.size = 2;
+        depth_.width = color.width;
+        depth_.height = color.height;
+        mark(depth_.addr, image_bytes(depth_));
+    }
+}
+
+void FramebufferTracker::mark(uint32_t addr, uint32_t bytes) {
+    if (!bytes || pages_.empty())
+        return;
+
+    const uint32_t last_page = static_cast<uint32_t>(pages_.size() - 1);
+    const uint32_t first = std::min(addr >> kPageShift, last_page);
+    const uint32_t last = std::min((addr + bytes - 1) >> kPageShift, last_page);
+    for (uint32_t page = first; page <= last; page++) {
+        if (pages_[page] != kUnsignalled) {
+            pages_[page] = kUnsignalled;
+            unsignalled_.push_back(page);
+        }
+    }
+}
+
+void FramebufferTracker::use_image(const Image& image) {
+    auto it = std::find_if(images_.begin(), images_.end(), [&](const Image& other) { return other.addr == image.addr; });
+    if (it != images_.end())
+        images_.erase(it);
+    images_.insert(images_.begin(), image);
+    // Leave the last slot for the depth image.
+    if (images_.size() > kMaxImages - 1)
+        images_.pop_back();
+}
+
+void FramebufferTracker::stamp(uint64_t timeline) {
+    for (uint32_t page : unsignalled_)
+        pages_[page] = timeline;
+    unsignalled_.clear();
+    // Further draws to the same images belong to the next signal.
+    marked_ = false;
+}
+
+void FramebufferTracker::completed(uint64_t timeline) {
+    completed_ = std::max(completed_, timeline);
+}
+
+uint64_t FramebufferTracker::pending(uint32_t addr) const {
+    const uint32_t page = (addr & kAddressMask) >> kPageShift;
+    if (page >= pages_.size())
+        return 0;
+
+    const uint64_t value = pages_[page];
+    return value > completed_ ? value : 0;
+}
+
+unsigned FramebufferTracker::images(Image* out, unsigned count) const {
+    unsigned n = 0;
+    for (const Image& image : images_) {
+        if (n == count)
+            return n;
+        out[n++] = image;
+    }
+
+    if (depth_.addr && depth_.size && n < count)
+        out[n++] = depth_;
+    return n;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Remembers which 4 KiB RDRAM pages are written by RDP work still in
+// flight, so CPU framebuffer accesses only wait for the submission that
+// covers their page instead of syncing the whole RDP on every SyncFull.
+//
+// Writes are recorded as commands are enqueued and belong to no timeline
+// value yet. stamp() hands them the value that was just signalled, and a
+// page is clean again once a wait covered its value.
+class FramebufferTracker {
+  public:
+    static const unsigned kPageShift = 12;
+    // Pending value of pages written by work which was not signalled yet.
+    static const uint64_t kUnsignalled = ~0ull;
+    static const unsigned kMaxImages = 6;
+
+    struct Image {
+        uint32_t addr;
+        uint32_t size; // bytes per pixel, 0 for 4-bit images
+        uint32_t width;
+        uint32_t height;
+    };
+
+    // Timeline values restart with every CommandProcessor.
+    void reset(uint32_t rdram_size);
+
+    // Feeds one enqueued RDP command, words as in the command list.
+    void command(const uint32_t* words);
+    void stamp(uint64_t timeline);
+    void completed(uint64_t timeline);
+
+    // Timeline value to wait for before the CPU touches addr, 0 if the
+    // page is clean. kUnsignalled means the work has to be signalled first.
+    uint64_t pending(uint32_t addr) const;
+
+    // Most recently used color images first, the depth image last.
+    unsigned images(Image* out, unsigned count) const;
+
+  private:
+    void mark(uint32_t addr, uint32_t bytes);
+    void mark_color();
+    void use_image(const Image& image);
+
+    std::vector<uint64_t> pages_;
+    std::vector<uint32_t> unsignalled_;
+    uint64_t completed_ = 0;
+
+    Image color_ = {};
+    Image depth_ = {};
+    bool depth_update_ = false;
+    // The current images are already marked for the next signal.
+    bool marked_ = false;
+
+    std::vector<Image> images_;
+};
@@ -23,19 +23,25 @@
 
 #define M64P_PLUGIN_PROTOTYPES 1
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <chrono>
 
 #include "gfx_1.3.h"
 #include "parallel_imp.h"
 #include "ini.h"
 #include "config_gui.h"
 #include "config.h"
+#include "profile.h"
 #include "queue_executor.h"
+#include "retroarch/slang_reflection.h"
+#include "retroarch/startup_profile.h"
+#include "retroarch/thread_policy.h"
 
 #include "git.h"
 
@@ -124,9 +130,71 @@ void plugin_close(void)
 {
 }
 
+static bool write_bmp(const char* path, const uint8_t* pixels, long width, long height)
+{
+    // pixels are bottom-up BGR24 rows, which is what BMP stores as well,
+    // only with rows padded to 4 bytes.
+    const long row = width * 3;
+    const long stride = (row + 3) & ~3l;
+    const uint8_t pad[3] = {};
+
+    BITMAPFILEHEADER file = {};
+    file.bfType = 0x4d42;
+    file.bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+    file.bfSize = file.bfOffBits + stride * height;
+
+    BITMAPINFOHEADER info = {};
+    info.biSize = sizeof(info);
+    info.biWidth = width;
+    info.biHeight = height;
+    info.biPlanes = 1;
+    info.biBitCount = 24;
+    info.biCompression = BI_RGB;
+    info.biSizeImage = stride * height;
+
+    FILE* out = fopen(path, "wb");
+    if (!out)
+        return false;
+
+    bool ok = fwrite(&file, sizeof(file), 1, out) == 1 && fwrite(&info, sizeof(info), 1, out) == 1;
+    for (long y = 0; ok && y < height; y++)
+    {
+        ok = fwrite(pixels + y * row, 1, row, out) == (size_t)row;
+        if (ok && stride != row)
+            ok = fwrite(pad, 1, stride - row, out) == (size_t)(stride - row);
+    }
+
+    ok = fclose(out) == 0 && ok;
+    return ok;
+}
+
 EXPORT void CALL CaptureScreen(char* directory)
 {
+    void* pixels = NULL;
+    long width = 0, height = 0;
+
+    sExecutor.sync([&]()
+        {
+            retro_read_screen(&pixels, &width, &height);
+        });
+    if (!pixels)
+        return;
+
+    char path[MAX_PATH];
+    size_t len = strlen(directory);
+    const char* sep = (len && directory[len - 1] != '\\' && directory[len - 1] != '/') ? "\\" : "";
+    for (int i = 0; i < 10000; i++)
+    {
+        snprintf(path, sizeof(path), "%s%sparaLLEl%04d.bmp", directory, sep, i);
+        if (GetFileAttributesA(path) != INVALID_FILE_ATTRIBUTES)
+            continue;
+
+        if (!write_bmp(path, (const uint8_t*)pixels, width, height))
+            msg_debug("CaptureScreen: failed to write %s", path);
+        break;
+    }
 
+    free(pixels);
 }
 
 EXPORT void CALL GetDllInfo(PLUGIN_INFO* PluginInfo)
@@ -145,9 +213,14 @@ EXPORT void CALL GetDllInfo(PLUGIN_INFO* PluginInfo)
 
 EXPORT BOOL CALL InitiateGFX(GFX_INFO Gfx_Info)
 {
+    char reflection_cache[MAX_PATH];
+
     // initialize config
     config_init();
 
+    ini_get_sibling_path("slang_reflection.bin", reflection_cache);
+    slang_reflection_cache_set_path(reflection_cache);
+
     gfx = Gfx_Info;
     hStatusBar = gfx.hStatusBar;
     plugin_init();
@@ -183,12 +256,14 @@ extern "C" void win32_set_hwnd(HWND hwnd);
 
 static bool m_fullscreen = false;
 static int m_width, m_height;
-static void init()
-{
-    RDP::upscaling = settings[KEY_UPSCALING].val;
-    RDP::super_sampled_read_back = settings[KEY_SSREADBACKS].val;
-    RDP::super_sampled_dither = settings[KEY_SSDITHER].val;
 
+// Settings the running renderer was set up with.
+static bool m_applied_valid = false;
+static int m_applied[NUM_CONFIGVARS];
+
+// CONFIG_RELOAD_SCANOUT keys, read by every process_commands/complete_frame.
+static void apply_frame_settings()
+{
     RDP::interlacing = settings[KEY_DEINTERLACE].val;
     RDP::overscan = settings[KEY_OVERSCANCROP].val;
     RDP::native_texture_lod = settings[KEY_NATIVETEXTLOD].val;
@@ -196,11 +271,32 @@ static void init()
     RDP::divot_filter = settings[KEY_DIVOT].val;
     RDP::gamma_dither = settings[KEY_GAMMADITHER].val;
     RDP::dither_filter = settings[KEY_VIDITHER].val;
-    RDP::interlacing = settings[KEY_DEINTERLACE].val;
     RDP::vi_aa = settings[KEY_AA].val;
     RDP::vi_scale = settings[KEY_VIBILERP].val;
     RDP::downscaling_steps = settings[KEY_DOWNSCALING].val;
     RDP::synchronous = settings[KEY_SYNCHRONOUS].val;
+}
+
+// CONFIG_RELOAD_FRONTEND keys, baked into the CommandProcessor.
+static void apply_frontend_settings()
+{
+    RDP::upscaling = settings[KEY_UPSCALING].val;
+    RDP::super_sampled_read_back = settings[KEY_SSREADBACKS].val;
+    RDP::super_sampled_dither = settings[KEY_SSDITHER].val;
+    RDP::auto_scaling = settings[KEY_AUTOSCALE].val;
+}
+
+static void record_applied_settings()
+{
+    for (int i = 0; i < NUM_CONFIGVARS; i++)
+        m_applied[i] = settings[i].val;
+    m_applied_valid = true;
+}
+
+static void init()
+{
+    apply_frontend_settings();
+    apply_frame_settings();
 
     if (!m_fullscreen)
     {
@@ -208,8 +304,77 @@ static void init()
 		m_height = settings[KEY_SCREEN_HEIGHT].val;
 	}
 
+    // init() always runs on the executor, this picks up placement changes.
+    thread_policy_enter(THREAD_ROLE_EXECUTOR);
+
     win32_set_hwnd(gfx.hWnd);
     retro_init(m_fullscreen, m_width, m_height);
+    record_applied_settings();
+}
+
+static void log_reload_cost(enum config_reload reload, std::chrono::steady_clock::time_point start)
+{
+    auto usec = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    msg_debug("paraLLEl: %s settings applied in %.3f ms", config_reload_name(reload), usec / 1000.0);
+}
+
+// Applies the minimal transition from the running settings to settings[].
+static void apply_settings()
+{
+    unsigned reload = m_applied_valid
+        ? config_diff(m_applied)
+        : CONFIG_RELOAD_BIT(CONFIG_RELOAD_DEVICE);
+
+    if (!reload)
+        return;
+
+    startup_profile_begin("settings", GIT_HEAD_SHA1);
+
+    if (reload & CONFIG_RELOAD_BIT(CONFIG_RELOAD_FRONTEND))
+    {
+        auto start = std::chrono::steady_clock::now();
+        apply_frontend_settings();
+        if (RDP::reinit_frontend())
+            log_reload_cost(CONFIG_RELOAD_FRONTEND, start);
+        else
+            reload |= CONFIG_RELOAD_BIT(CONFIG_RELOAD_DEVICE);
+    }
+
+    if (reload & CONFIG_RELOAD_BIT(CONFIG_RELOAD_DEVICE))
+    {
+        // init() picks up every other class as well.
+        auto start = std::chrono::steady_clock::now();
+        retro_deinit();
+        init();
+        log_reload_cost(CONFIG_RELOAD_DEVICE, start);
+        return;
+    }
+
+    if (reload & CONFIG_RELOAD_BIT(CONFIG_RELOAD_THREADS))
+    {
+        // The mailbox and worker roles pick it up on their next enter.
+        auto start = std::chrono::steady_clock::now();
+        thread_policy_enter(THREAD_ROLE_EXECUTOR);
+        log_reload_cost(CONFIG_RELOAD_THREADS, start);
+    }
+
+    if (reload & CONFIG_RELOAD_BIT(CONFIG_RELOAD_SWAPCHAIN))
+    {
+        auto start = std::chrono::steady_clock::now();
+        retro_apply_swapchain();
+        log_reload_cost(CONFIG_RELOAD_SWAPCHAIN, start);
+    }
+
+    if (reload & CONFIG_RELOAD_BIT(CONFIG_RELOAD_SCANOUT))
+    {
+        auto start = std::chrono::steady_clock::now();
+        apply_frame_settings();
+        retro_apply_presentation();
+        log_reload_cost(CONFIG_RELOAD_SCANOUT, start);
+    }
+
+    record_applied_settings();
 }
 
 EXPORT void CALL DllConfig(HWND hParent)
@@ -219,16 +384,59 @@ EXPORT void CALL DllConfig(HWND hParent)
         {
             // reload settings
             config_load();
-            retro_deinit();
-            init();
+            apply_settings();
         });
 }
 
+// Picks up the ROM's profile: its overrides and what past sessions measured.
+static void open_profile()
+{
+    int tuned = 0;
+
+    profile_open(gfx.HEADER);
+    config_load();
+    profile_get_result(PROFILE_RESULT_UPSCALING, &tuned);
+    RDP::tuned_upscaling = tuned;
+
+    int gpu_us = 0;
+    if (profile_get_result(PROFILE_RESULT_RDP_GPU_US, &gpu_us))
+        msg_debug("paraLLEl: profile %s, last session RDP %.2f ms per frame at %dx", profile_section(), gpu_us / 1000.0, tuned);
+}
+
+static void close_profile()
+{
+    if (RDP::gpu_frame_ms() > 0.0)
+    {
+        profile_set_result(PROFILE_RESULT_RDP_GPU_US, int(RDP::gpu_frame_ms() * 1000.0));
+        profile_set_result(PROFILE_RESULT_UPSCALING, RDP::active_upscaling());
+        ini_flush();
+    }
+
+    // Back to the global settings for the config dialog.
+    profile_close();
+    config_load();
+    RDP::tuned_upscaling = 0;
+}
+
+// Only touched on the executor, which also presents it.
+static retro_perf_hud m_perf_hud;
+// Emulator thread side of the HUD.
+static std::chrono::steady_clock::time_point m_last_show;
+
 EXPORT void CALL RomOpen(void)
 {
     // Vulkan does not seem to be particularly happy about multithreading either although it might work
-    sExecutor.start(false /*same thread exec*/);
-    sExecutor.sync(init);
+    sExecutor.start(false /*same thread exec*/, [](std::chrono::steady_clock::duration latency)
+        {
+            thread_policy_wake(thread_policy_now_us() - std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+        });
+    m_last_show = {};
+    sExecutor.sync([]()
+        {
+            startup_profile_begin("RomOpen", GIT_HEAD_SHA1);
+            open_profile();
+            init();
+        });
 }
 
 EXPORT void CALL DrawScreen(void)
@@ -237,21 +445,65 @@ EXPORT void CALL DrawScreen(void)
 
 EXPORT void CALL ReadScreen(void **dest, long *width, long *height)
 {
+    // The first read after a while stalls once, after that every frame is
+    // copied out as part of its own submission and reads don't wait.
+    sExecutor.sync([=]()
+        {
+            retro_read_screen(dest, width, height);
+        });
 }
 
 EXPORT void CALL RomClosed(void)
 {
-    sExecutor.async(retro_deinit);
+    sExecutor.async([]()
+        {
+            m_applied_valid = false;
+            retro_set_perf_hud(nullptr);
+            m_perf_hud = {};
+            close_profile();
+            retro_deinit();
+            thread_policy_leave();
+        });
     sExecutor.stop();
 }
 
+static void update_perf_hud(float cpu_ms)
+{
+    if (!settings[KEY_PERF_HUD].val)
+    {
+        retro_set_perf_hud(nullptr);
+        return;
+    }
+
+    m_perf_hud.cpu_ms[m_perf_hud.head] = cpu_ms;
+    m_perf_hud.gpu_ms[m_perf_hud.head] = float(RDP::last_gpu_frame_ms());
+    m_perf_hud.head = (m_perf_hud.head + 1) % RETRO_PERF_HUD_HISTORY;
+    // Not counting the task running this.
+    m_perf_hud.queue_depth = unsigned(sExecutor.depth() - 1);
+    m_perf_hud.frames_in_flight = RDP::frames_in_flight();
+    m_perf_hud.commands = RDP::commands_per_frame();
+    retro_set_perf_hud(&m_perf_hud);
+}
+
 EXPORT void CALL ShowCFB(void)
 {
-    sExecutor.async([]() {
+    // Emulator time between frames, minus what it spent blocked on the executor.
+    auto shown = std::chrono::steady_clock::now();
+    auto sync_wait = sExecutor.takeSyncWait();
+    float cpu_ms = 0.0f;
+    if (m_last_show.time_since_epoch().count())
+        cpu_ms = std::chrono::duration<float, std::milli>(shown - m_last_show - sync_wait).count();
+    m_last_show = shown;
+
+    sExecutor.async([=]() {
         RDP::complete_frame();
+        update_perf_hud(cpu_ms);
         RDP::profile_refresh_begin();
         retro_video_refresh(RETRO_HW_FRAME_BUFFER_VALID, RDP::width, RDP::height, 0);
         RDP::profile_refresh_end();
+        startup_profile_frame();
+        // From the emulator handing over the frame to it being presented.
+        m_perf_hud.present_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - shown).count();
     });
 }
 
@@ -328,6 +580,7 @@ static void screen_toggle_fullscreen()
         // restore window size and position
         SetWindowPlacement(gfx.hWnd, &old_pos);
     }
+    startup_profile_begin("fullscreen", GIT_HEAD_SHA1);
     retro_deinit();
     init();
 }
@@ -339,14 +592,49 @@ EXPORT void CALL ChangeWindow(void)
 
 EXPORT void CALL FBWrite(DWORD addr, DWORD size)
 {
+    sExecutor.sync([=]()
+        {
+            RDP::framebuffer_write(addr, size);
+        });
+}
+
+EXPORT void CALL FBWList(FrameBufferModifyEntry *plist, DWORD size)
+{
+    sExecutor.sync([=]()
+        {
+            for (DWORD i = 0; i < size; i++)
+                RDP::framebuffer_write(plist[i].addr, plist[i].size);
+        });
 }
 
 EXPORT void CALL FBRead(DWORD addr)
 {
+    sExecutor.sync([=]()
+        {
+            RDP::framebuffer_read(addr);
+        });
 }
 
 EXPORT void CALL FBGetFrameBufferInfo(void *pinfo)
 {
+    // The emulator passes room for FramebufferTracker::kMaxImages entries.
+    FrameBufferInfo* info = (FrameBufferInfo*)pinfo;
+    FramebufferTracker::Image images[FramebufferTracker::kMaxImages];
+    unsigned count = 0;
+
+    sExecutor.sync([&]()
+        {
+            count = RDP::framebuffer_images(images, FramebufferTracker::kMaxImages);
+        });
+
+    memset(info, 0, sizeof(FrameBufferInfo) * FramebufferTracker::kMaxImages);
+    for (unsigned i = 0; i < count; i++)
+    {
+        info[i].addr = images[i].addr;
+        info[i].size = images[i].size;
+        info[i].width = images[i].width;
+        info[i].height = images[i].height;
+    }
 }
 
 EXPORT BOOL APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpReserved)
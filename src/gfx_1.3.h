@@ -334,6 +334,14 @@ pinfo is pointed to a FrameBufferInfo structure which to be
 filled in by this function
 output:   Values are return in the FrameBufferInfo structure
 ************************************************************************/
+typedef struct
+{
+    DWORD addr;
+    DWORD size;
+    DWORD width;
+    DWORD height;
+} FrameBufferInfo;
+
 EXPORT void CALL FBGetFrameBufferInfo(void *pinfo);
 
 #ifdef _WIN32
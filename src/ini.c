@@ -4,10 +4,106 @@
 #include <shlwapi.h>
 #include <windows.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 char ini_file[MAX_PATH];
 
-void ini_init()
+// The whole file is kept in memory: it is parsed once on first use and
+// every change is written back as a complete file.
+struct ini_entry
+{
+	char section[INI_NAME_LEN];
+	char key[INI_NAME_LEN];
+	int value;
+};
+
+// The config dialog saves from the UI thread while the executor loads
+// and writes profiles, so every entry point holds ini_lock.
+static SRWLOCK ini_lock = SRWLOCK_INIT;
+static struct ini_entry* ini_entries;
+static int ini_count;
+static int ini_capacity;
+static bool ini_dirty;
+
+static void ini_strip(char* str)
+{
+	size_t len = strlen(str);
+	while (len && (str[len - 1] == '\n' || str[len - 1] == '\r' || str[len - 1] == ' ' || str[len - 1] == '\t'))
+		str[--len] = '\0';
+}
+
+static struct ini_entry* ini_find(const char* section, const char* key)
+{
+	for (int i = 0; i < ini_count; i++)
+	{
+		if (!lstrcmpiA(ini_entries[i].section, section) && !lstrcmpiA(ini_entries[i].key, key))
+			return &ini_entries[i];
+	}
+	return NULL;
+}
+
+static struct ini_entry* ini_add(const char* section, const char* key)
+{
+	if (ini_count == ini_capacity)
+	{
+		int capacity = ini_capacity ? ini_capacity * 2 : 64;
+		struct ini_entry* entries = (struct ini_entry*)realloc(ini_entries, capacity * sizeof(*entries));
+		if (!entries)
+			return NULL;
+		ini_entries = entries;
+		ini_capacity = capacity;
+	}
+
+	struct ini_entry* entry = &ini_entries[ini_count++];
+	lstrcpynA(entry->section, section, INI_NAME_LEN);
+	lstrcpynA(entry->key, key, INI_NAME_LEN);
+	entry->value = 0;
+	return entry;
+}
+
+static void ini_load(void)
+{
+	char line[256];
+	char section[INI_NAME_LEN] = "";
+
+	ini_count = 0;
+
+	FILE* file = fopen(ini_file, "r");
+	if (!file)
+		return;
+
+	while (fgets(line, sizeof(line), file))
+	{
+		ini_strip(line);
+		if (line[0] == '[')
+		{
+			char* end = strchr(line, ']');
+			if (end)
+			{
+				*end = '\0';
+				lstrcpynA(section, line + 1, INI_NAME_LEN);
+			}
+			continue;
+		}
+
+		char* eq = strchr(line, '=');
+		if (!eq || !section[0] || line[0] == ';')
+			continue;
+
+		*eq = '\0';
+		struct ini_entry* entry = ini_find(section, line);
+		if (!entry)
+			entry = ini_add(section, line);
+		if (entry)
+			entry->value = atoi(eq + 1);
+	}
+
+	fclose(file);
+}
+
+static void ini_init_locked(void)
 {
 	if ('\0' != *ini_file)
 		return;
@@ -21,26 +117,119 @@ void ini_init()
 	PathAppend(ini_file, "LParallel");
 	CreateDirectory(ini_file, NULL); // can fail, ignore errors
 	PathAppend(ini_file, "cfg.ini");
+	ini_load();
+}
+
+void ini_init()
+{
+	AcquireSRWLockExclusive(&ini_lock);
+	ini_init_locked();
+	ReleaseSRWLockExclusive(&ini_lock);
+}
+
+void ini_get_sibling_path(const char* name, char* out)
+{
+	AcquireSRWLockExclusive(&ini_lock);
+	ini_init_locked();
+	lstrcpyn(out, ini_file, MAX_PATH);
+	ReleaseSRWLockExclusive(&ini_lock);
+	PathRemoveFileSpec(out);
+	PathAppend(out, name);
+}
+
+bool ini_set_section_value(const char* section, const char* key, int value)
+{
+	AcquireSRWLockExclusive(&ini_lock);
+	ini_init_locked();
+	struct ini_entry* entry = ini_find(section, key);
+	if (!entry)
+	{
+		entry = ini_add(section, key);
+		if (!entry)
+		{
+			ReleaseSRWLockExclusive(&ini_lock);
+			return false;
+		}
+		ini_dirty = true;
+	}
+
+	if (entry->value != value)
+		ini_dirty = true;
+	entry->value = value;
+	ReleaseSRWLockExclusive(&ini_lock);
+	return true;
+}
+
+bool ini_get_section_value(const char* section, const char* key, int* value)
+{
+	AcquireSRWLockExclusive(&ini_lock);
+	ini_init_locked();
+	struct ini_entry* entry = ini_find(section, key);
+	if (entry)
+		*value = entry->value;
+	ReleaseSRWLockExclusive(&ini_lock);
+	return entry != NULL;
 }
 
 bool ini_set_value(const char* key, int value)
 {
-	char num_str[10];
-	itoa(value, num_str, 10);
-    return WritePrivateProfileStringA("Settings", key, num_str, ini_file);
+	return ini_set_section_value(INI_SETTINGS_SECTION, key, value);
 }
 
 bool ini_get_value(const char* key, int* value)
 {
-    char buf[MAX_PATH];
-    GetPrivateProfileStringA("Settings", key, NULL, buf, MAX_PATH, ini_file);
-    if (buf == NULL)
-    {
-    	*value = 0;
-        return false;
-    }
+	return ini_get_section_value(INI_SETTINGS_SECTION, key, value);
+}
+
+static bool ini_flush_locked(void)
+{
+	char tmp_file[MAX_PATH + 4];
+
+	ini_init_locked();
+	if (!ini_dirty)
+		return true;
 
-    *value = atoi(buf);
-    return true;
+	// Write a sibling file and swap it in so a crash mid-write can never
+	// leave a truncated cfg.ini behind.
+	snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", ini_file);
+	FILE* file = fopen(tmp_file, "w");
+	if (!file)
+		return false;
+
+	for (int i = 0; i < ini_count; i++)
+	{
+		bool seen = false;
+		for (int j = 0; j < i && !seen; j++)
+			seen = !lstrcmpiA(ini_entries[j].section, ini_entries[i].section);
+		if (seen)
+			continue;
+
+		fprintf(file, "[%s]\n", ini_entries[i].section);
+		for (int j = i; j < ini_count; j++)
+		{
+			if (!lstrcmpiA(ini_entries[j].section, ini_entries[i].section))
+				fprintf(file, "%s=%d\n", ini_entries[j].key, ini_entries[j].value);
+		}
+	}
+
+	bool ok = fflush(file) == 0;
+	ok = fclose(file) == 0 && ok;
+	if (ok)
+		ok = MoveFileExA(tmp_file, ini_file, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+	if (!ok)
+	{
+		DeleteFileA(tmp_file);
+		return false;
+	}
+
+	ini_dirty = false;
+	return true;
 }
 
+bool ini_flush(void)
+{
+	AcquireSRWLockExclusive(&ini_lock);
+	bool ok = ini_flush_locked();
+	ReleaseSRWLockExclusive(&ini_lock);
+	return ok;
+}
@@ -4,10 +4,27 @@
 #include <stdbool.h>
 #include <windows.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INI_NAME_LEN 64
+#define INI_SETTINGS_SECTION "Settings"
+
 extern char ini_file[MAX_PATH];
 
 extern void ini_init(void);
+// Values live in memory until ini_flush() rewrites cfg.ini in one go.
 extern bool ini_set_value(const char* key, int value);
 extern bool ini_get_value(const char* key, int* value);
+extern bool ini_set_section_value(const char* section, const char* key, int value);
+extern bool ini_get_section_value(const char* section, const char* key, int* value);
+extern bool ini_flush(void);
+// Path of a file stored next to cfg.ini, out must hold MAX_PATH chars.
+extern void ini_get_sibling_path(const char* name, char* out);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif // INI_H
@@ -3,8 +3,16 @@
 #include "gfxstructdefs.h"
 #include "retroarch/video_driver.h"
 #include "retroarch/retroarch.h"
+#include "retroarch/startup_profile.h"
+#include "retroarch/thread_policy.h"
+#include "fb_tracker.h"
+#include "scale_governor.h"
+#include "thread_id.hpp"
 
 #include <assert.h>
+#include <chrono>
+#include <deque>
+#include <future>
 
 using namespace Vulkan;
 using namespace std;
@@ -30,8 +38,39 @@ static unique_ptr<Device> device;
 static unique_ptr<Context> context;
 static QueryPoolHandle begin_ts, end_ts;
 
+// GPU time of frames still in flight, consumed by the frame time average
+// and the scale governor once their timestamps have landed.
+struct FrameTimestamps
+{
+	QueryPoolHandle begin, end;
+};
+static deque<FrameTimestamps> frame_timestamps;
+static const size_t max_frame_timestamps = 16;
+
+static double gpu_ms_average, gpu_ms_last;
+static const double gpu_ms_weight = 0.05;
+
+// RDP commands enqueued since the last complete_frame, and for the last frame.
+static unsigned frame_commands, last_frame_commands;
+
+// RDRAM pages written by RDP work in flight, for FBRead/FBWrite.
+static FramebufferTracker fb_tracker;
+
+static ScaleGovernor governor;
+static ScaleGovernor::Level active_level;
+static ScaleGovernor::Level pending_level;
+static future<unique_ptr<CommandProcessor>> pending_frontend;
+
+// Signalled after every flushed scanout, the frontend waits on it instead
+// of relying on submission order on the shared queue.
+static VkSemaphore scanout_timeline;
+static uint64_t scanout_timeline_value;
+static bool scanout_signal_pending;
+
 static vector<retro_vulkan_image> retro_images;
 static vector<ImageHandle> retro_image_handles;
+// Presented while a frontend warms up, recorded before the worker starts.
+static ImageHandle blank_image;
 unsigned width, height;
 unsigned overscan;
 unsigned upscaling = 1;
@@ -41,6 +80,43 @@ bool native_tex_rect = true;
 bool synchronous = true, divot_filter = true, gamma_dither = true;
 bool vi_aa = true, vi_scale = true, dither_filter = true;
 bool interlacing = true, super_sampled_read_back = false, super_sampled_dither = true;
+bool auto_scaling = false;
+unsigned tuned_upscaling = 0;
+
+static void wait_for_frontend();
+static ImageHandle create_blank_image();
+
+// Granite thread indices, each owns its own per-frame command pools. The
+// executor and the RDP command ring record on the first, frontend builds
+// on a worker get their own so the pools are never used concurrently.
+enum : unsigned
+{
+	THREAD_INDEX_EXECUTOR = 0,
+	THREAD_INDEX_WORKER,
+	THREAD_INDEX_COUNT
+};
+
+// The renderer records its RDP work as async compute, which Granite puts on
+// a dedicated compute queue when parallel_create_device found one. The VI
+// scanout then runs on the graphics queue after a semaphore wait, so the
+// next frame's RDP work overlaps with scanout and the filter chain.
+bool async_compute()
+{
+	if (!context)
+		return false;
+	auto &info = context->get_queue_info();
+	return info.queues[QUEUE_INDEX_COMPUTE] != info.queues[QUEUE_INDEX_GRAPHICS];
+}
+
+static void log_async_compute()
+{
+	auto &info = context->get_queue_info();
+	if (async_compute())
+		log_cb(RETRO_LOG_INFO, "RDP work runs on compute queue family %u, scanout on graphics family %u.\n",
+		       info.family_indices[QUEUE_INDEX_COMPUTE], info.family_indices[QUEUE_INDEX_GRAPHICS]);
+	else
+		log_cb(RETRO_LOG_INFO, "No separate compute queue, RDP work shares the graphics queue.\n");
+}
 
 static const unsigned cmd_len_lut[64] = {
 	1, 1, 1, 1, 1, 1, 1, 1, 4, 6, 12, 14, 12, 14, 20, 22,
@@ -65,6 +141,11 @@ void process_commands()
 	if ((cmd_ptr + length) & ~(0x0003FFFF >> 3))
 		return;
 
+	// Commands can't be deferred past RDRAM changes, so the first RDP work
+	// after RomOpen waits for the warm-up instead of being dropped.
+	if (!frontend)
+		wait_for_frontend();
+
 	uint32_t offset = DP_CURRENT;
 	if (*GET_GFX_INFO(DPC_STATUS_REG) & DP_STATUS_XBUS_DMA)
 	{
@@ -109,13 +190,22 @@ void process_commands()
 		}
 
 		if (command >= 8 && frontend)
+		{
 			frontend->enqueue_command(cmd_length * 2, &cmd_data[2 * cmd_cur]);
+			fb_tracker.command(&cmd_data[2 * cmd_cur]);
+			frame_commands++;
+		}
 
 		if (RDP::Op(command) == RDP::Op::SyncFull)
 		{
 			// For synchronous RDP:
 			if (synchronous && frontend)
-				frontend->wait_for_timeline(frontend->signal_timeline());
+			{
+				uint64_t value = frontend->signal_timeline();
+				fb_tracker.stamp(value);
+				frontend->wait_for_timeline(value);
+				fb_tracker.completed(value);
+			}
 			*gfx.MI_INTR_REG |= DP_INTERRUPT;
 			gfx.CheckInterrupts();
 		}
@@ -128,6 +218,46 @@ void process_commands()
 	*GET_GFX_INFO(DPC_START_REG) = *GET_GFX_INFO(DPC_CURRENT_REG) = *GET_GFX_INFO(DPC_END_REG);
 }
 
+// Waits for in-flight RDP writes to the page holding addr.
+static void wait_for_page(uint32_t addr)
+{
+	if (!frontend)
+		return;
+
+	uint64_t value = fb_tracker.pending(addr);
+	if (!value)
+		return;
+
+	if (value == FramebufferTracker::kUnsignalled)
+	{
+		value = frontend->signal_timeline();
+		fb_tracker.stamp(value);
+	}
+	frontend->wait_for_timeline(value);
+	fb_tracker.completed(value);
+}
+
+void framebuffer_read(uint32_t addr)
+{
+	wait_for_page(addr);
+}
+
+void framebuffer_write(uint32_t addr, uint32_t size)
+{
+	// The store lands once the notification returns, so it must not race
+	// RDP work still writing the same page.
+	// Every page of the range, a store can span more than two.
+	uint32_t first = addr >> FramebufferTracker::kPageShift;
+	uint32_t last = (addr + (size ? size - 1 : 0)) >> FramebufferTracker::kPageShift;
+	for (uint32_t page = first; page <= last; page++)
+		wait_for_page(page << FramebufferTracker::kPageShift);
+}
+
+unsigned framebuffer_images(FramebufferTracker::Image *images, unsigned count)
+{
+	return fb_tracker.images(images, count);
+}
+
 static QueryPoolHandle refresh_begin_ts;
 
 void profile_refresh_begin()
@@ -167,34 +297,36 @@ void begin_frame()
 	//pending_timeline_value = timeline_value;
 }
 
-bool init()
+// Everything create_frontend reads from the settings. It is copied on the
+// executor, which is where the settings are written, so a frontend built
+// on a worker never reads them while they change.
+struct FrontendSettings
 {
-	if (!context || !vulkan)
-		return false;
-
-	unsigned mask = vulkan->get_sync_index_mask(vulkan->handle);
-	unsigned num_frames = 0;
-	unsigned num_sync_frames = 0;
-	for (unsigned i = 0; i < 32; i++)
-	{
-		if (mask & (1u << i))
-		{
-			num_frames = i + 1;
-			num_sync_frames++;
-		}
-	}
+	unsigned upscaling;
+	bool super_sampled_read_back;
+	bool super_sampled_dither;
+	bool native_texture_lod;
+	bool native_tex_rect;
+};
 
-	retro_images.resize(num_frames);
-	retro_image_handles.resize(num_frames);
+static FrontendSettings snapshot_frontend_settings(unsigned scale)
+{
+	FrontendSettings settings;
+	settings.upscaling = scale;
+	settings.super_sampled_read_back = super_sampled_read_back;
+	settings.super_sampled_dither = super_sampled_dither;
+	settings.native_texture_lod = native_texture_lod;
+	settings.native_tex_rect = native_tex_rect;
+	return settings;
+}
 
-	device.reset(new Device);
-	device->set_context(*context);
-	device->init_frame_contexts(num_sync_frames);
-	log_cb(RETRO_LOG_INFO, "Using %u sync frames for parallel-RDP.\n", num_sync_frames);
-	device->set_queue_lock(
-			[]() { vulkan->lock_queue(vulkan->handle); },
-			[]() { vulkan->unlock_queue(vulkan->handle); });
+// What the running and the pending frontend were built with. A governor
+// step only changes the scale, everything else stays with the running one.
+static FrontendSettings active_settings;
+static FrontendSettings pending_settings;
 
+static unique_ptr<CommandProcessor> create_frontend(const FrontendSettings &settings)
+{
 	uintptr_t aligned_rdram = reinterpret_cast<uintptr_t>(gfx.RDRAM);
 	uintptr_t offset = 0;
 
@@ -207,7 +339,7 @@ bool init()
 		if (offset)
 		{
 			log_cb(RETRO_LOG_ERROR, "Host RDRAM is not aligned properly! Make sure to use align RDRAM to 64 KiB!\n");
-			return false;
+			return {};
 		}
 		aligned_rdram -= offset;
 	}
@@ -217,11 +349,11 @@ bool init()
 	if (rdram_size == 0)
 	{
 		log_cb(RETRO_LOG_ERROR, "RDRAM size is 0, was graphics initialized too early?\n");
-		return false;
+		return {};
 	}
 
 	CommandProcessorFlags flags = 0;
-	switch (upscaling)
+	switch (settings.upscaling)
 	{
 		case 2:
 			flags |= COMMAND_PROCESSOR_FLAG_UPSCALING_2X_BIT;
@@ -242,26 +374,157 @@ bool init()
 			break;
 	}
 
-	if (upscaling > 1 && super_sampled_read_back)
+	if (settings.upscaling > 1 && settings.super_sampled_read_back)
 		flags |= COMMAND_PROCESSOR_FLAG_SUPER_SAMPLED_READ_BACK_BIT;
-	if (super_sampled_dither)
+	if (settings.super_sampled_dither)
 		flags |= COMMAND_PROCESSOR_FLAG_SUPER_SAMPLED_DITHER_BIT;
 
 	log_cb(RETRO_LOG_INFO, "paraLLEl-RDP: Using RDRAM size of %u bytes.\n", rdram_size);
-	frontend.reset(new CommandProcessor(*device, reinterpret_cast<void *>(aligned_rdram),
+	unique_ptr<CommandProcessor> processor(new CommandProcessor(*device, reinterpret_cast<void *>(aligned_rdram),
 				offset, rdram_size, rdram_size / 2, flags));
 
-	if (!frontend->device_is_supported())
+	if (!processor->device_is_supported())
 	{
 		log_cb(RETRO_LOG_ERROR, "This device probably does not support 8/16-bit storage. Make sure you're using up-to-date drivers!\n");
-		frontend.reset();
-		return false;
+		return {};
 	}
 
 	RDP::Quirks quirks;
-	quirks.set_native_texture_lod(native_texture_lod);
-	quirks.set_native_resolution_tex_rect(native_tex_rect);
-	frontend->set_quirks(quirks);
+	quirks.set_native_texture_lod(settings.native_texture_lod);
+	quirks.set_native_resolution_tex_rect(settings.native_tex_rect);
+	processor->set_quirks(quirks);
+	return processor;
+}
+
+static unique_ptr<CommandProcessor> create_frontend_async(FrontendSettings settings)
+{
+	// Recording on the executor's index would race its command pools, the
+	// device's frame lock keeps frames from recycling this index's pools
+	// while a command buffer is outstanding.
+	Util::register_thread_index(THREAD_INDEX_WORKER);
+	thread_policy_enter(THREAD_ROLE_WORKER);
+	unsigned phase = startup_phase_begin("RDP frontend");
+	auto processor = create_frontend(settings);
+	startup_phase_end(phase);
+	thread_policy_leave();
+	return processor;
+}
+
+static void drop_pending_frontend()
+{
+	if (pending_frontend.valid())
+		pending_frontend.get();
+}
+
+// With warm_up the frontend is built on a worker and swapped in by
+// complete_frame/process_commands once ready.
+static bool init_frontend(bool warm_up)
+{
+	drop_pending_frontend();
+	frame_timestamps.clear();
+	gpu_ms_average = 0.0;
+	gpu_ms_last = 0.0;
+	frame_commands = last_frame_commands = 0;
+
+	// The governor only ever steps below what the user configured.
+	governor.reset(upscaling, downscaling_steps, 1000.0 / 60.0);
+	if (auto_scaling && tuned_upscaling)
+		governor.start_at(tuned_upscaling);
+	pending_level = auto_scaling ? governor.level() : governor.configured();
+	fb_tracker.reset(rdram_size);
+	pending_settings = snapshot_frontend_settings(pending_level.upscaling);
+
+	if (warm_up)
+	{
+		if (!blank_image)
+			blank_image = create_blank_image();
+		pending_frontend = async(launch::async, create_frontend_async, pending_settings);
+		return true;
+	}
+
+	frontend = create_frontend(pending_settings);
+	if (!frontend)
+		return false;
+
+	active_level = pending_level;
+	active_settings = pending_settings;
+	return true;
+}
+
+static void init_scanout_timeline()
+{
+	scanout_timeline = VK_NULL_HANDLE;
+	scanout_timeline_value = 0;
+	scanout_signal_pending = false;
+	if (!vulkan->set_image_timeline || !device->get_device_features().vk12_features.timelineSemaphore)
+	{
+		log_cb(RETRO_LOG_INFO, "Timeline semaphores unavailable, scanout is ordered by queue submission.\n");
+		return;
+	}
+
+	VkSemaphoreTypeCreateInfo type_info = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+	type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	VkSemaphoreCreateInfo info = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+	info.pNext = &type_info;
+	if (device->get_device_table().vkCreateSemaphore(device->get_device(), &info, nullptr, &scanout_timeline) != VK_SUCCESS)
+		scanout_timeline = VK_NULL_HANDLE;
+}
+
+// Called once Granite flushed the scanout, so the signal lands behind it.
+static void signal_scanout()
+{
+	if (!scanout_signal_pending)
+		return;
+	scanout_signal_pending = false;
+
+	VkTimelineSemaphoreSubmitInfo timeline_info = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+	timeline_info.signalSemaphoreValueCount = 1;
+	timeline_info.pSignalSemaphoreValues = &scanout_timeline_value;
+	VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+	submit.pNext = &timeline_info;
+	submit.signalSemaphoreCount = 1;
+	submit.pSignalSemaphores = &scanout_timeline;
+
+	vulkan->lock_queue(vulkan->handle);
+	device->get_device_table().vkQueueSubmit(vulkan->queue, 1, &submit, VK_NULL_HANDLE);
+	vulkan->unlock_queue(vulkan->handle);
+}
+
+bool init()
+{
+	if (!context || !vulkan)
+		return false;
+
+	unsigned mask = vulkan->get_sync_index_mask(vulkan->handle);
+	unsigned num_frames = 0;
+	unsigned num_sync_frames = 0;
+	for (unsigned i = 0; i < 32; i++)
+	{
+		if (mask & (1u << i))
+		{
+			num_frames = i + 1;
+			num_sync_frames++;
+		}
+	}
+
+	retro_images.resize(num_frames);
+	retro_image_handles.resize(num_frames);
+
+	unsigned phase = startup_phase_begin("RDP device");
+	context->set_num_thread_indices(THREAD_INDEX_COUNT);
+	device.reset(new Device);
+	device->set_context(*context);
+	device->init_frame_contexts(num_sync_frames);
+	startup_phase_end(phase);
+	log_cb(RETRO_LOG_INFO, "Using %u sync frames for parallel-RDP.\n", num_sync_frames);
+	log_async_compute();
+	device->set_queue_lock(
+			[]() { vulkan->lock_queue(vulkan->handle); },
+			[]() { vulkan->unlock_queue(vulkan->handle); });
+	init_scanout_timeline();
+
+	if (!init_frontend(true))
+		return false;
 
 	timeline_value = 0;
 	pending_timeline_value = 0;
@@ -270,42 +533,76 @@ bool init()
 	return true;
 }
 
+bool reinit_frontend()
+{
+	if (!device)
+		return false;
+
+	drop_pending_frontend();
+	if (frontend)
+	{
+		// Let the old frontend drain before its RDRAM mapping goes away.
+		frontend->wait_for_timeline(frontend->signal_timeline());
+		frontend.reset();
+	}
+	device->wait_idle();
+
+	unsigned phase = startup_phase_begin("RDP frontend");
+	bool ok = init_frontend(false);
+	startup_phase_end(phase);
+	if (!ok)
+		return false;
+
+	timeline_value = 0;
+	pending_timeline_value = 0;
+	return true;
+}
+
 void deinit()
 {
 	begin_ts.reset();
 	end_ts.reset();
+	frame_timestamps.clear();
 	retro_image_handles.clear();
+	blank_image.reset();
 	retro_images.clear();
+	drop_pending_frontend();
 	frontend.reset();
+	if (scanout_timeline != VK_NULL_HANDLE)
+	{
+		device->wait_idle();
+		device->get_device_table().vkDestroySemaphore(device->get_device(), scanout_timeline, nullptr);
+		scanout_timeline = VK_NULL_HANDLE;
+	}
 	device.reset();
 	context.reset();
 }
 
-static void complete_frame_error()
+static ImageHandle create_blank_image()
 {
-	static const char error_tex[] =
-		"ooooooooooooooooooooooooo"
-		"ooXXXXXoooXXXXXoooXXXXXoo"
-		"ooXXooooooXoooXoooXoooXoo"
-		"ooXXXXXoooXXXXXoooXXXXXoo"
-		"ooXXXXXoooXoXoooooXoXoooo"
-		"ooXXooooooXooXooooXooXooo"
-		"ooXXXXXoooXoooXoooXoooXoo"
-		"ooooooooooooooooooooooooo";
-
-	auto info = Vulkan::ImageCreateInfo::immutable_2d_image(50, 16, VK_FORMAT_R8G8B8A8_UNORM, false);
-	info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	auto info = Vulkan::ImageCreateInfo::immutable_2d_image(1, 1, VK_FORMAT_R8G8B8A8_UNORM);
+	info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 	info.misc = IMAGE_MISC_MUTABLE_SRGB_BIT;
+	info.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	auto image = device->create_image(info);
+
+	auto cmd = device->request_command_buffer();
+	cmd->image_barrier(*image,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+	cmd->clear_image(*image, {});
+	cmd->image_barrier(*image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	device->submit(cmd);
+	return image;
+}
 
-	Vulkan::ImageInitialData data = {};
-
-	uint32_t tex_data[16][50];
-	for (unsigned y = 0; y < 16; y++)
-		for (unsigned x = 0; x < 50; x++)
-			tex_data[y][x] = error_tex[25 * (y >> 1) + (x >> 1)] != 'o' ? 0xffffffffu : 0u;
-	data.data = tex_data;
-	auto image = device->create_image(info, &data);
-
+static void present_image(const ImageHandle &image)
+{
 	unsigned index = vulkan->get_sync_index(vulkan->handle);
 	assert(index < retro_images.size());
 
@@ -326,24 +623,156 @@ static void complete_frame_error()
 	retro_images[index].create_info.components.b = VK_COMPONENT_SWIZZLE_B;
 	retro_images[index].create_info.components.a = VK_COMPONENT_SWIZZLE_A;
 
-	vulkan->set_image(vulkan->handle, &retro_images[index], 0, nullptr, VK_QUEUE_FAMILY_IGNORED);
+	// Scanout writes the image on the graphics queue even when the RDP work ran on
+	// the compute queue, so the frontend never needs an ownership transfer here.
+	if (scanout_timeline != VK_NULL_HANDLE)
+	{
+		scanout_signal_pending = true;
+		vulkan->set_image_timeline(vulkan->handle, &retro_images[index], scanout_timeline,
+		                           ++scanout_timeline_value, VK_QUEUE_FAMILY_IGNORED);
+	}
+	else
+		vulkan->set_image(vulkan->handle, &retro_images[index], 0, nullptr, VK_QUEUE_FAMILY_IGNORED);
 	width = image->get_width();
 	height = image->get_height();
 	retro_image_handles[index] = image;
+}
+
+static void complete_frame_error()
+{
+	static const char error_tex[] =
+		"ooooooooooooooooooooooooo"
+		"ooXXXXXoooXXXXXoooXXXXXoo"
+		"ooXXooooooXoooXoooXoooXoo"
+		"ooXXXXXoooXXXXXoooXXXXXoo"
+		"ooXXXXXoooXoXoooooXoXoooo"
+		"ooXXooooooXooXooooXooXooo"
+		"ooXXXXXoooXoooXoooXoooXoo"
+		"ooooooooooooooooooooooooo";
 
+	auto info = Vulkan::ImageCreateInfo::immutable_2d_image(50, 16, VK_FORMAT_R8G8B8A8_UNORM, false);
+	info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	info.misc = IMAGE_MISC_MUTABLE_SRGB_BIT;
+
+	Vulkan::ImageInitialData data = {};
+
+	uint32_t tex_data[16][50];
+	for (unsigned y = 0; y < 16; y++)
+		for (unsigned x = 0; x < 50; x++)
+			tex_data[y][x] = error_tex[25 * (y >> 1) + (x >> 1)] != 'o' ? 0xffffffffu : 0u;
+	data.data = tex_data;
+	present_image(device->create_image(info, &data));
 	device->flush_frame();
+	signal_scanout();
+}
+
+static void complete_frame_blank()
+{
+	present_image(blank_image ? blank_image : create_blank_image());
+	device->flush_frame();
+	signal_scanout();
+}
+
+static double timestamp_delta_ms(const QueryPoolResult &begin, const QueryPoolResult &end)
+{
+	if (begin.is_device_timebase())
+		return device->convert_device_timestamp_delta(begin.get_timestamp_ticks(), end.get_timestamp_ticks()) * 1000.0;
+
+	// Calibrated timestamps are already in host nanoseconds.
+	return double(end.get_timestamp_ticks() - begin.get_timestamp_ticks()) * 1e-6;
+}
+
+static void consume_frame_timestamps()
+{
+	while (!frame_timestamps.empty())
+	{
+		auto &ts = frame_timestamps.front();
+		if (!ts.begin->is_signalled() || !ts.end->is_signalled())
+			break;
+
+		double gpu_ms = timestamp_delta_ms(*ts.begin, *ts.end);
+		frame_timestamps.pop_front();
+		gpu_ms_last = gpu_ms;
+
+		if (gpu_ms_average == 0.0)
+			gpu_ms_average = gpu_ms;
+		else
+			gpu_ms_average += (gpu_ms - gpu_ms_average) * gpu_ms_weight;
+
+		if (!auto_scaling)
+			continue;
+
+		// Keep sampling while a frontend is being built so the average
+		// stays current, but do not queue a second rebuild on top.
+		if (!governor.add_sample(gpu_ms) || pending_frontend.valid())
+			continue;
+
+		pending_level = governor.level();
+		pending_settings = active_settings;
+		pending_settings.upscaling = pending_level.upscaling;
+		log_cb(RETRO_LOG_INFO, "Scale governor: RDP at %.2f ms per frame, switching to %ux upscaling with %u downscale steps.\n",
+				governor.average_ms(), pending_level.upscaling, pending_level.downscaling_steps);
+		pending_frontend = async(launch::async, create_frontend_async, pending_settings);
+	}
+}
+
+static void swap_pending_frontend()
+{
+	if (!pending_frontend.valid() ||
+	    pending_frontend.wait_for(chrono::seconds(0)) != future_status::ready)
+		return;
+
+	auto processor = pending_frontend.get();
+	if (!processor)
+	{
+		if (frontend)
+			log_cb(RETRO_LOG_WARN, "Scale governor: failed to create frontend for %ux upscaling, keeping %ux.\n",
+					pending_level.upscaling, active_level.upscaling);
+		return;
+	}
+
+	if (frontend)
+		frontend->wait_for_timeline(frontend->signal_timeline());
+	frontend = move(processor);
+	active_level = pending_level;
+	active_settings = pending_settings;
+	timeline_value = 0;
+	pending_timeline_value = 0;
+	fb_tracker.reset(rdram_size);
+	log_cb(RETRO_LOG_INFO, "paraLLEl-RDP: frontend ready, %ux upscaling with %u downscale steps.\n",
+			active_level.upscaling, active_level.downscaling_steps);
+}
+
+static void wait_for_frontend()
+{
+	if (pending_frontend.valid())
+	{
+		pending_frontend.wait();
+		swap_pending_frontend();
+	}
 }
 
 void complete_frame()
 {
+	if (!frontend)
+		swap_pending_frontend();
+
 	if (!frontend)
 	{
-		complete_frame_error();
+		// Still warming up, present black until the frontend is ready.
+		if (pending_frontend.valid())
+			complete_frame_blank();
+		else
+			complete_frame_error();
 		device->next_frame_context();
 		return;
 	}
 
+	last_frame_commands = frame_commands;
+	frame_commands = 0;
+
 	timeline_value = frontend->signal_timeline();
+	fb_tracker.stamp(timeline_value);
 
 	frontend->set_vi_register(VIRegister::Control, *GET_GFX_INFO(VI_STATUS_REG));
 	frontend->set_vi_register(VIRegister::Origin, *GET_GFX_INFO(VI_ORIGIN_REG));
@@ -369,59 +798,23 @@ void complete_frame()
 	opts.vi.gamma_dither = gamma_dither;
 	opts.blend_previous_frame = interlacing;
 	opts.upscale_deinterlacing = !interlacing;
-	opts.downscale_steps = downscaling_steps;
+	opts.downscale_steps = auto_scaling ? active_level.downscaling_steps : downscaling_steps;
 	opts.crop_overscan_pixels = overscan;
 	auto image = frontend->scanout(opts);
-	unsigned index = vulkan->get_sync_index(vulkan->handle);
-
 	if (!image)
-	{
-		auto info = Vulkan::ImageCreateInfo::immutable_2d_image(1, 1, VK_FORMAT_R8G8B8A8_UNORM);
-		info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
-			VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-		info.misc = IMAGE_MISC_MUTABLE_SRGB_BIT;
-		info.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
-		image = device->create_image(info);
-
-		auto cmd = device->request_command_buffer();
-		cmd->image_barrier(*image,
-				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
-				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
-		cmd->clear_image(*image, {});
-		cmd->image_barrier(*image,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
-				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
-		device->submit(cmd);
-	}
-
-	assert(index < retro_images.size());
-
-	retro_images[index].image_view = image->get_view().get_view();
-	retro_images[index].image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-	retro_images[index].create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	retro_images[index].create_info.image = image->get_image();
-	retro_images[index].create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	retro_images[index].create_info.format = VK_FORMAT_R8G8B8A8_UNORM;
-	retro_images[index].create_info.subresourceRange.baseMipLevel = 0;
-	retro_images[index].create_info.subresourceRange.baseArrayLayer = 0;
-	retro_images[index].create_info.subresourceRange.levelCount = 1;
-	retro_images[index].create_info.subresourceRange.layerCount = 1;
-	retro_images[index].create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	retro_images[index].create_info.components.r = VK_COMPONENT_SWIZZLE_R;
-	retro_images[index].create_info.components.g = VK_COMPONENT_SWIZZLE_G;
-	retro_images[index].create_info.components.b = VK_COMPONENT_SWIZZLE_B;
-	retro_images[index].create_info.components.a = VK_COMPONENT_SWIZZLE_A;
-
-	vulkan->set_image(vulkan->handle, &retro_images[index], 0, nullptr, VK_QUEUE_FAMILY_IGNORED);
-	width = image->get_width();
-	height = image->get_height();
-	retro_image_handles[index] = image;
+		image = create_blank_image();
+	present_image(image);
 
 	end_ts = device->write_calibrated_timestamp();
 	device->register_time_interval("Emulation", begin_ts, end_ts, "frame");
+	if (begin_ts)
+	{
+		frame_timestamps.push_back({ begin_ts, end_ts });
+		if (frame_timestamps.size() > max_frame_timestamps)
+			frame_timestamps.pop_front();
+	}
+	consume_frame_timestamps();
+	swap_pending_frontend();
 	begin_ts.reset();
 	end_ts.reset();
 
@@ -431,6 +824,7 @@ void complete_frame()
 	frontend->set_quirks(quirks);
 
 	frontend->begin_frame_context();
+	signal_scanout();
 }
 
 bool parallel_create_device(struct retro_vulkan_context *frontend_context, VkInstance instance, VkPhysicalDevice gpu,
@@ -468,6 +862,31 @@ bool parallel_create_device(struct retro_vulkan_context *frontend_context, VkIns
 	return true;
 }
 
+double gpu_frame_ms()
+{
+	return gpu_ms_average;
+}
+
+double last_gpu_frame_ms()
+{
+	return gpu_ms_last;
+}
+
+unsigned frames_in_flight()
+{
+	return unsigned(frame_timestamps.size());
+}
+
+unsigned commands_per_frame()
+{
+	return last_frame_commands;
+}
+
+unsigned active_upscaling()
+{
+	return active_level.upscaling;
+}
+
 static const VkApplicationInfo parallel_app_info = {
 	VK_STRUCTURE_TYPE_APPLICATION_INFO,
 	nullptr,
@@ -5,14 +5,24 @@
 #include "context.hpp"
 #include "device.hpp"
 #include "retroarch/retroarch.h"
+#include "fb_tracker.h"
 
 namespace RDP
 {
 bool init();
 void deinit();
+// Recreates the CommandProcessor with the current upscaling settings.
+bool reinit_frontend();
 void begin_frame();
 
 void process_commands();
+
+// CPU access to RDRAM the RDP may still be writing. Only waits for the
+// submission covering the page, so synchronous can stay off.
+void framebuffer_read(uint32_t addr);
+void framebuffer_write(uint32_t addr, uint32_t size);
+// Color/depth images recently drawn to, see FramebufferTracker::images.
+unsigned framebuffer_images(FramebufferTracker::Image *images, unsigned count);
 extern const struct retro_hw_render_interface_vulkan *vulkan;
 
 extern unsigned width;
@@ -22,12 +32,29 @@ extern unsigned overscan;
 extern unsigned downscaling_steps;
 extern bool synchronous, divot_filter, gamma_dither, vi_aa, vi_scale, dither_filter, interlacing;
 extern bool native_texture_lod, native_tex_rect, super_sampled_read_back, super_sampled_dither;
+// Lets the scale governor lower upscaling/raise downscaling under GPU load.
+extern bool auto_scaling;
+// Upscale factor the governor starts from, 0 for the configured one.
+extern unsigned tuned_upscaling;
 
 void complete_frame();
 void deinit();
 
 void profile_refresh_begin();
 void profile_refresh_end();
+
+// Smoothed RDP GPU time per frame, 0 until a frame has been measured.
+double gpu_frame_ms();
+// GPU time of the most recent frame whose timestamps landed.
+double last_gpu_frame_ms();
+// Frames submitted whose GPU timestamps have not landed yet.
+unsigned frames_in_flight();
+// RDP commands enqueued for the last completed frame.
+unsigned commands_per_frame();
+// Upscale factor of the running frontend.
+unsigned active_upscaling();
+// RDP work runs on its own compute queue, overlapping the previous scanout.
+bool async_compute();
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "ini.h"
+#include "profile.h"
+
+static char profile_name[INI_NAME_LEN];
+
+void profile_open(const unsigned char* header)
+{
+	uint32_t crc1, crc2;
+
+	if (!header)
+	{
+		profile_close();
+		return;
+	}
+
+	// The header arrives word swapped like RDRAM, so the CRCs read back
+	// as native integers.
+	memcpy(&crc1, header + 0x10, sizeof(crc1));
+	memcpy(&crc2, header + 0x14, sizeof(crc2));
+	snprintf(profile_name, sizeof(profile_name), "ROM %08X-%08X", crc1, crc2);
+}
+
+void profile_close(void)
+{
+	profile_name[0] = '\0';
+}
+
+const char* profile_section(void)
+{
+	return profile_name[0] ? profile_name : NULL;
+}
+
+bool profile_overrides(const char* key)
+{
+	int value;
+	return profile_name[0] && ini_get_section_value(profile_name, key, &value);
+}
+
+void profile_apply(void)
+{
+	if (!profile_name[0])
+		return;
+
+	for (int i = 0; i < NUM_CONFIGVARS; i++)
+	{
+		int value;
+		if (ini_get_section_value(profile_name, settings[i].name, &value))
+			settings[i].val = value;
+	}
+}
+
+bool profile_get_result(const char* key, int* value)
+{
+	return profile_name[0] && ini_get_section_value(profile_name, key, value);
+}
+
+void profile_set_result(const char* key, int value)
+{
+	if (profile_name[0])
+		ini_set_section_value(profile_name, key, value);
+}
@@ -0,0 +1,34 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+
+// Per-ROM profiles, stored as "[ROM <crc1>-<crc2>]" sections of cfg.ini.
+// Any KEY_* setting present in a profile overrides the global value while
+// that ROM is open, RESULT_* values are measurements from past sessions.
+#define PROFILE_RESULT_RDP_GPU_US "RESULT_RDP_GPU_US"
+#define PROFILE_RESULT_UPSCALING "RESULT_UPSCALING"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	// header is the first 0x40 bytes of the ROM as handed to the plugin.
+	extern void profile_open(const unsigned char* header);
+	extern void profile_close(void);
+
+	// Section of the open ROM, or NULL outside of a ROM session.
+	extern const char* profile_section(void);
+	extern bool profile_overrides(const char* key);
+
+	// Overlays the open ROM's overrides onto settings[].
+	extern void profile_apply(void);
+
+	extern bool profile_get_result(const char* key, int* value);
+	extern void profile_set_result(const char* key, int value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PROFILE_H
@@ -1,12 +1,13 @@
 #include "queue_executor.h"
 
-void QueueExecutor::start(bool allowSameThreadExec) {
+void QueueExecutor::start(bool allowSameThreadExec, WakeFn onWake) {
     std::lock_guard lck(initMutex_);
     if (running_)
         return;
 
     running_ = true;
     allowSameThreadExec_ = allowSameThreadExec;
+    onWake_ = std::move(onWake);
     tasks_.clear();
     executor_ = std::thread{ &QueueExecutor::loop, this };
 }
@@ -17,6 +18,8 @@ QueueExecutor::SyncToken QueueExecutor::sync(Fn fn) {
     {
         std::unique_lock<std::mutex> lck(mutex_);
         notify = tasks_.empty();
+        if (notify)
+            notifiedAt_ = std::chrono::steady_clock::now();
         if (allowSameThreadExec_ && tasks_.empty()) {
             task->steal();
         }
@@ -26,7 +29,7 @@ QueueExecutor::SyncToken QueueExecutor::sync(Fn fn) {
     if (notify)
         cv_.notify_one();
 
-    return SyncToken{ std::move(task) };
+    return SyncToken{ std::move(task), &syncWaitNs_ };
 }
 
 void QueueExecutor::async(Fn fn) {
@@ -35,6 +38,8 @@ void QueueExecutor::async(Fn fn) {
     {
         std::unique_lock<std::mutex> lck(mutex_);
         notify = tasks_.empty();
+        if (notify)
+            notifiedAt_ = std::chrono::steady_clock::now();
         tasks_.emplace_back(std::move(task));
     }
 
@@ -42,6 +47,15 @@ void QueueExecutor::async(Fn fn) {
         cv_.notify_one();
 }
 
+size_t QueueExecutor::depth() {
+    std::unique_lock<std::mutex> lck(mutex_);
+    return tasks_.size();
+}
+
+std::chrono::nanoseconds QueueExecutor::takeSyncWait() {
+    return std::chrono::nanoseconds{ syncWaitNs_.exchange(0) };
+}
+
 void QueueExecutor::stop() {
     std::lock_guard lck(initMutex_);
     if (!running_)
@@ -56,12 +70,17 @@ void QueueExecutor::stop() {
 void QueueExecutor::loop() {
     std::unique_lock<std::mutex> lck(mutex_);
     while (running_) {
-        if (tasks_.empty())
+        bool slept = tasks_.empty();
+        if (slept)
             cv_.wait(lck, [&] { return !tasks_.empty(); });
 
         auto task = std::move(tasks_.front());
+        auto notifiedAt = notifiedAt_;
         lck.unlock();
 
+        if (slept && onWake_)
+            onWake_(std::chrono::steady_clock::now() - notifiedAt);
+
         task->process();
 
         lck.lock();
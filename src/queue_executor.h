@@ -6,6 +6,7 @@
 // Similarly to macOS impl 'async' always ex
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <deque>
 #include <functional>
@@ -15,6 +16,8 @@
 class QueueExecutor {
   public:
     using Fn = std::function<void()>;
+    // Called on the executor after it slept, with the time it took from the notify to running again
+    using WakeFn = std::function<void(std::chrono::steady_clock::duration)>;
     QueueExecutor() = default;
 
     class Task {
@@ -68,38 +71,53 @@ class QueueExecutor {
     {
     public:
         SyncToken() = default;
-        explicit SyncToken(std::shared_ptr<SyncTask>&& task)
-            : task_(std::forward<std::shared_ptr<SyncTask>>(task)) {
+        SyncToken(std::shared_ptr<SyncTask>&& task, std::atomic<int64_t>* waited)
+            : task_(std::forward<std::shared_ptr<SyncTask>>(task)), waited_(waited) {
         }
 
         SyncToken(const SyncToken&) = delete;
         SyncToken& operator=(const SyncToken&) = delete;
 
-        SyncToken(SyncToken&& other) : task_(std::move(other.task_)) {
+        SyncToken(SyncToken&& other) : task_(std::move(other.task_)), waited_(other.waited_) {
         }
 
         SyncToken& operator=(SyncToken&& other) {
-            if (task_)
-                task_->tokenDtor();
+            finish();
 
             task_ = std::move(other.task_);
+            waited_ = other.waited_;
             return *this;
         }
 
         ~SyncToken() {
-            if (task_)
-                task_->tokenDtor();
+            finish();
         }
 
     private:
+        void finish() {
+            if (!task_)
+                return;
+
+            auto start = std::chrono::steady_clock::now();
+            task_->tokenDtor();
+            if (waited_)
+                *waited_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+
         std::shared_ptr<SyncTask> task_;
+        std::atomic<int64_t>* waited_ = nullptr;
     };
 
-    void start(bool allowSameThreadExec);
+    void start(bool allowSameThreadExec, WakeFn onWake = nullptr);
     SyncToken sync(Fn);
     void async(Fn);
     void stop();
 
+    // Tasks queued or running
+    size_t depth();
+    // Time callers spent waiting on 'sync' tasks since the last call
+    std::chrono::nanoseconds takeSyncWait();
+
   private:
     class AsyncTask final : public Task {
       public:
@@ -126,6 +144,12 @@ class QueueExecutor {
     std::deque<TaskPtr> tasks_;
     bool running_ = false;
 
+    // When the sleeping executor was notified, for 'onWake_'
+    std::chrono::steady_clock::time_point notifiedAt_;
+    WakeFn onWake_;
+
+    std::atomic<int64_t> syncWaitNs_ = 0;
+
     // The Executor as it goes
     std::thread executor_;
 
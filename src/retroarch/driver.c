@@ -18,6 +18,7 @@
 
 #include "video_driver.h"
 #include "gfx_display.h"
+#include "startup_profile.h"
 
 void drivers_init(
     settings_t* settings,
@@ -27,6 +28,7 @@ void drivers_init(
     video_driver_state_t
         * video_st = video_state_get_ptr();
     bool video_is_threaded = false;
+    unsigned phase;
     gfx_display_t* p_disp = disp_get_ptr();
 
     /* Initialize video driver */
@@ -36,13 +38,19 @@ void drivers_init(
 
         video_driver_lock_new();
         video_driver_set_cached_frame_ptr(NULL);
+        phase = startup_phase_begin("video_driver_init_internal");
         if (!video_driver_init_internal(&video_is_threaded,
             verbosity_enabled))
             retroarch_fail(1, "video_driver_init_internal()");
+        startup_phase_end(phase);
 
         if (!video_st->cache_context_ack
             && hwr->context_reset)
+        {
+            phase = startup_phase_begin("context_reset");
             hwr->context_reset();
+            startup_phase_end(phase);
+        }
     }
 
 #if 0
@@ -14,10 +14,90 @@
  *  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <ctype.h>
+#include <string.h>
+
 #include "gfx_display.h"
 
 #include "vulkan_common.h"
 
+/* Built-in 3x5 glyphs for ' ' to 'Z', one row per octal digit,
+ * top row first and the leftmost pixel in the high bit. */
+#define VK_GLYPH(r0, r1, r2, r3, r4) \
+   (((r0) << 12) | ((r1) << 9) | ((r2) << 6) | ((r3) << 3) | (r4))
+#define VK_GLYPH_FIRST ' '
+#define VK_GLYPH_LAST 'Z'
+#define VK_GLYPH_WIDTH 3
+#define VK_GLYPH_HEIGHT 5
+/* Atlas cells keep a blank column and row around each glyph. */
+#define VK_GLYPH_CELL_WIDTH 4
+#define VK_GLYPH_CELL_HEIGHT 6
+#define VK_GLYPH_COLUMNS 16
+#define VK_GLYPH_ATLAS_WIDTH (VK_GLYPH_COLUMNS * VK_GLYPH_CELL_WIDTH)
+#define VK_GLYPH_ATLAS_HEIGHT (4 * VK_GLYPH_CELL_HEIGHT)
+
+static const uint16_t vk_glyphs[VK_GLYPH_LAST - VK_GLYPH_FIRST + 1] = {
+   VK_GLYPH(0, 0, 0, 0, 0), /*   */
+   VK_GLYPH(2, 2, 2, 0, 2), /* ! */
+   VK_GLYPH(5, 5, 0, 0, 0), /* " */
+   VK_GLYPH(5, 7, 5, 7, 5), /* # */
+   VK_GLYPH(3, 6, 2, 3, 6), /* $ */
+   VK_GLYPH(5, 1, 2, 4, 5), /* % */
+   VK_GLYPH(2, 5, 2, 5, 3), /* & */
+   VK_GLYPH(2, 2, 0, 0, 0), /* ' */
+   VK_GLYPH(1, 2, 2, 2, 1), /* ( */
+   VK_GLYPH(4, 2, 2, 2, 4), /* ) */
+   VK_GLYPH(0, 5, 2, 5, 0), /* * */
+   VK_GLYPH(0, 2, 7, 2, 0), /* + */
+   VK_GLYPH(0, 0, 0, 2, 4), /* , */
+   VK_GLYPH(0, 0, 7, 0, 0), /* - */
+   VK_GLYPH(0, 0, 0, 0, 2), /* . */
+   VK_GLYPH(1, 1, 2, 4, 4), /* / */
+   VK_GLYPH(7, 5, 5, 5, 7), /* 0 */
+   VK_GLYPH(2, 6, 2, 2, 7), /* 1 */
+   VK_GLYPH(7, 1, 7, 4, 7), /* 2 */
+   VK_GLYPH(7, 1, 7, 1, 7), /* 3 */
+   VK_GLYPH(5, 5, 7, 1, 1), /* 4 */
+   VK_GLYPH(7, 4, 7, 1, 7), /* 5 */
+   VK_GLYPH(7, 4, 7, 5, 7), /* 6 */
+   VK_GLYPH(7, 1, 1, 1, 1), /* 7 */
+   VK_GLYPH(7, 5, 7, 5, 7), /* 8 */
+   VK_GLYPH(7, 5, 7, 1, 7), /* 9 */
+   VK_GLYPH(0, 2, 0, 2, 0), /* : */
+   VK_GLYPH(0, 2, 0, 2, 4), /* ; */
+   VK_GLYPH(1, 2, 4, 2, 1), /* < */
+   VK_GLYPH(0, 7, 0, 7, 0), /* = */
+   VK_GLYPH(4, 2, 1, 2, 4), /* > */
+   VK_GLYPH(7, 1, 3, 0, 2), /* ? */
+   VK_GLYPH(7, 5, 7, 4, 7), /* @ */
+   VK_GLYPH(2, 5, 7, 5, 5), /* A */
+   VK_GLYPH(6, 5, 6, 5, 6), /* B */
+   VK_GLYPH(3, 4, 4, 4, 3), /* C */
+   VK_GLYPH(6, 5, 5, 5, 6), /* D */
+   VK_GLYPH(7, 4, 6, 4, 7), /* E */
+   VK_GLYPH(7, 4, 6, 4, 4), /* F */
+   VK_GLYPH(3, 4, 5, 5, 3), /* G */
+   VK_GLYPH(5, 5, 7, 5, 5), /* H */
+   VK_GLYPH(7, 2, 2, 2, 7), /* I */
+   VK_GLYPH(1, 1, 1, 5, 2), /* J */
+   VK_GLYPH(5, 5, 6, 5, 5), /* K */
+   VK_GLYPH(4, 4, 4, 4, 7), /* L */
+   VK_GLYPH(5, 7, 7, 5, 5), /* M */
+   VK_GLYPH(6, 5, 5, 5, 5), /* N */
+   VK_GLYPH(2, 5, 5, 5, 2), /* O */
+   VK_GLYPH(6, 5, 6, 4, 4), /* P */
+   VK_GLYPH(2, 5, 5, 6, 3), /* Q */
+   VK_GLYPH(6, 5, 6, 5, 5), /* R */
+   VK_GLYPH(3, 4, 2, 1, 6), /* S */
+   VK_GLYPH(7, 2, 2, 2, 2), /* T */
+   VK_GLYPH(5, 5, 5, 5, 7), /* U */
+   VK_GLYPH(5, 5, 5, 5, 2), /* V */
+   VK_GLYPH(5, 5, 7, 7, 5), /* W */
+   VK_GLYPH(5, 5, 2, 5, 5), /* X */
+   VK_GLYPH(5, 5, 2, 2, 2), /* Y */
+   VK_GLYPH(7, 1, 2, 4, 7), /* Z */
+};
+
  /* Will do Y-flip later, but try to make it similar to GL. */
 static const float vk_vertexes[] = {
    0, 0,
@@ -58,6 +138,124 @@ static const float* gfx_display_vk_get_default_tex_coords(void)
     return &vk_tex_coords[0];
 }
 
+struct vk_texture vulkan_create_glyph_atlas(vk_t* vk)
+{
+    unsigned i, x, y;
+    uint8_t pixels[VK_GLYPH_ATLAS_WIDTH * VK_GLYPH_ATLAS_HEIGHT];
+
+    memset(pixels, 0, sizeof(pixels));
+    for (i = 0; i < sizeof(vk_glyphs) / sizeof(vk_glyphs[0]); i++)
+    {
+        uint8_t* cell = pixels
+            + (i / VK_GLYPH_COLUMNS) * VK_GLYPH_CELL_HEIGHT * VK_GLYPH_ATLAS_WIDTH
+            + (i % VK_GLYPH_COLUMNS) * VK_GLYPH_CELL_WIDTH;
+
+        for (y = 0; y < VK_GLYPH_HEIGHT; y++)
+            for (x = 0; x < VK_GLYPH_WIDTH; x++)
+                if (vk_glyphs[i] & (1 << ((VK_GLYPH_HEIGHT - 1 - y) * 3 + (VK_GLYPH_WIDTH - 1 - x))))
+                    cell[y * VK_GLYPH_ATLAS_WIDTH + x] = 0xff;
+    }
+
+    return vulkan_create_texture(vk, NULL,
+        VK_GLYPH_ATLAS_WIDTH, VK_GLYPH_ATLAS_HEIGHT, VK_FORMAT_R8_UNORM,
+        pixels, NULL, VULKAN_TEXTURE_STATIC);
+}
+
+float vulkan_batch_text(vk_t* vk, float x, float y, unsigned scale,
+    const char* text, const struct vk_color* color)
+{
+    struct vk_batch_quad quad;
+    float start = x;
+    float pixel_width, pixel_height;
+
+    if (vk->vk_vp.width <= 0.0f || vk->vk_vp.height <= 0.0f)
+        return 0.0f;
+
+    pixel_width = (float)scale / vk->vk_vp.width;
+    pixel_height = (float)scale / vk->vk_vp.height;
+
+    quad.y = y;
+    quad.width = VK_GLYPH_WIDTH * pixel_width;
+    quad.height = VK_GLYPH_HEIGHT * pixel_height;
+    quad.tex_width = (float)VK_GLYPH_WIDTH / VK_GLYPH_ATLAS_WIDTH;
+    quad.tex_height = (float)VK_GLYPH_HEIGHT / VK_GLYPH_ATLAS_HEIGHT;
+    quad.color = *color;
+
+    for (; *text; text++, x += VK_GLYPH_CELL_WIDTH * pixel_width)
+    {
+        unsigned index;
+        int c = toupper((unsigned char)*text);
+
+        if (c == ' ')
+            continue;
+        if (c < VK_GLYPH_FIRST || c > VK_GLYPH_LAST)
+            c = '?';
+
+        index = c - VK_GLYPH_FIRST;
+        quad.x = x;
+        quad.tex_x = (float)((index % VK_GLYPH_COLUMNS) * VK_GLYPH_CELL_WIDTH) / VK_GLYPH_ATLAS_WIDTH;
+        quad.tex_y = (float)((index / VK_GLYPH_COLUMNS) * VK_GLYPH_CELL_HEIGHT) / VK_GLYPH_ATLAS_HEIGHT;
+        vulkan_batch_quad(vk, vk->pipelines.font, &vk->display.glyphs,
+            vk->samplers.nearest, &quad);
+    }
+
+    return x - start;
+}
+
+/* Single colored, axis aligned quads over the default vertices can be
+ * batched in swapchain space instead of getting a viewport each. */
+static bool gfx_display_vk_batch(vk_t* vk, gfx_display_ctx_draw_t* draw,
+    struct vk_texture* texture, VkSampler sampler,
+    const float* vertex, const float* tex_coord, const float* color)
+{
+    unsigned i;
+    struct vk_batch_quad quad;
+    float width = vk->context->swapchain_width;
+    float height = vk->context->swapchain_height;
+
+    if (draw->prim_type != GFX_DISPLAY_PRIM_TRIANGLESTRIP
+        || draw->coords->vertices != 4
+        || vertex != vk_vertexes
+        || (draw->matrix_data && draw->matrix_data != &vk->mvp_no_rot))
+        return false;
+
+    for (i = 4; i < 16; i++)
+        if (color[i] != color[i & 3])
+            return false;
+
+    if (vk->vk_vp.x != 0.0f || vk->vk_vp.y != 0.0f
+        || vk->vk_vp.width != width || vk->vk_vp.height != height)
+    {
+        vulkan_batch_flush(vk);
+        vk->vk_vp.x = 0.0f;
+        vk->vk_vp.y = 0.0f;
+        vk->vk_vp.width = width;
+        vk->vk_vp.height = height;
+        vk->vk_vp.minDepth = 0.0f;
+        vk->vk_vp.maxDepth = 1.0f;
+        vk->tracker.dirty |= VULKAN_DIRTY_DYNAMIC_BIT;
+    }
+
+    /* The third vertex is the top left one after the Y-flip,
+     * the second one the bottom right. */
+    quad.x = draw->x / width;
+    quad.y = (height - draw->y - draw->height) / height;
+    quad.width = draw->width / width;
+    quad.height = draw->height / height;
+    quad.tex_x = tex_coord[4];
+    quad.tex_y = tex_coord[5];
+    quad.tex_width = tex_coord[2] - tex_coord[4];
+    quad.tex_height = tex_coord[3] - tex_coord[5];
+    quad.color.r = color[0];
+    quad.color.g = color[1];
+    quad.color.b = color[2];
+    quad.color.a = color[3];
+
+    vulkan_batch_quad(vk, vk->display.pipelines[vk->display.blend],
+        texture, sampler, &quad);
+    return true;
+}
+
 static void gfx_display_vk_draw(gfx_display_ctx_draw_t* draw,
     void* data, unsigned video_width, unsigned video_height)
 {
@@ -68,6 +266,7 @@ static void gfx_display_vk_draw(gfx_display_ctx_draw_t* draw,
     const float* tex_coord = NULL;
     const float* color = NULL;
     struct vk_vertex* pv = NULL;
+    VkSampler sampler;
     vk_t* vk = (vk_t*)data;
 
     if (!vk || !draw)
@@ -89,6 +288,18 @@ static void gfx_display_vk_draw(gfx_display_ctx_draw_t* draw,
     if (!color)
         color = &vk_colors[0];
 
+    sampler = texture->mipmap ?
+        vk->samplers.mipmap_linear :
+        (texture->default_smooth ? vk->samplers.linear
+            : vk->samplers.nearest);
+
+    if (gfx_display_vk_batch(vk, draw, texture, sampler,
+        vertex, tex_coord, color))
+        return;
+
+    /* Queued quads were laid out for the old viewport. */
+    vulkan_batch_flush(vk);
+
     vk->vk_vp.x = draw->x;
     vk->vk_vp.y = vk->context->swapchain_height - draw->y - draw->height;
     vk->vk_vp.width = draw->width;
@@ -100,7 +311,7 @@ static void gfx_display_vk_draw(gfx_display_ctx_draw_t* draw,
 
     /* Bake interleaved VBO. Kinda ugly, we should probably try to move to
      * an interleaved model to begin with ... */
-    if (!vulkan_buffer_chain_alloc(vk->context, &vk->chain->vbo,
+    if (!vulkan_buffer_ring_alloc(vk->context, &vk->vbo_ring, &vk->chain->vbo,
         draw->coords->vertices * sizeof(struct vk_vertex), &range))
         return;
 
@@ -129,10 +340,7 @@ static void gfx_display_vk_draw(gfx_display_ctx_draw_t* draw,
             (vk->display.blend << 0);
         call.pipeline = vk->display.pipelines[disp_pipeline];
         call.texture = texture;
-        call.sampler = texture->mipmap ?
-            vk->samplers.mipmap_linear :
-            (texture->default_smooth ? vk->samplers.linear
-                : vk->samplers.nearest);
+        call.sampler = sampler;
         call.uniform = draw->matrix_data
             ? draw->matrix_data : &vk->mvp_no_rot;
         call.uniform_size = sizeof(math_matrix_4x4);
@@ -176,6 +384,7 @@ static void gfx_display_vk_scissor_begin(
 {
     vk_t* vk = (vk_t*)data;
 
+    vulkan_batch_flush(vk);
     vk->tracker.use_scissor = true;
     vk->tracker.scissor.offset.x = x;
     vk->tracker.scissor.offset.y = y;
@@ -190,6 +399,7 @@ static void gfx_display_vk_scissor_end(void* data,
 {
     vk_t* vk = (vk_t*)data;
 
+    vulkan_batch_flush(vk);
     vk->tracker.use_scissor = false;
     vk->tracker.dirty |= VULKAN_DIRTY_DYNAMIC_BIT;
 }
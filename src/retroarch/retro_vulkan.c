@@ -14,6 +14,7 @@
  *  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stddef.h>
 #include <stdint.h>
 #include <math.h>
 #include <string.h>
@@ -24,6 +25,8 @@
 #include "driver.h"
 #include "video_driver.h"
 #include "shader_vulkan.h"
+#include "startup_profile.h"
+#include "thread_policy.h"
 #include "matrix_4x4.h"
 
 static void vulkan_set_viewport(void* data, unsigned viewport_width,
@@ -187,6 +190,40 @@ static void vulkan_init_pipeline_layout(
 
     vkCreatePipelineLayout(vk->context->device,
         &layout_info, NULL, &vk->pipelines.layout);
+
+    /* Update templates for the quad bindings, see
+     * struct vk_quad_descriptor_data. */
+    {
+        unsigned i;
+        VkDescriptorUpdateTemplateEntry entries[2];
+        VkDescriptorUpdateTemplateCreateInfo template_info = {
+           VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO };
+
+        entries[0].dstBinding = 0;
+        entries[0].dstArrayElement = 0;
+        entries[0].descriptorCount = 1;
+        entries[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        entries[0].offset = offsetof(struct vk_quad_descriptor_data, buffer);
+        entries[0].stride = sizeof(struct vk_quad_descriptor_data);
+
+        entries[1].dstBinding = 1;
+        entries[1].dstArrayElement = 0;
+        entries[1].descriptorCount = 1;
+        entries[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        entries[1].offset = offsetof(struct vk_quad_descriptor_data, image);
+        entries[1].stride = sizeof(struct vk_quad_descriptor_data);
+
+        template_info.pDescriptorUpdateEntries = entries;
+        template_info.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+        template_info.descriptorSetLayout = vk->pipelines.set_layout;
+
+        for (i = 0; i < 2; i++)
+        {
+            template_info.descriptorUpdateEntryCount = i + 1;
+            vkCreateDescriptorUpdateTemplate(vk->context->device,
+                &template_info, NULL, &vk->pipelines.quad_templates[i]);
+        }
+    }
 }
 
 static void vulkan_init_pipelines(vk_t* vk)
@@ -273,8 +310,6 @@ static void vulkan_init_pipelines(vk_t* vk)
        VK_DYNAMIC_STATE_SCISSOR,
     };
 
-    vulkan_init_pipeline_layout(vk);
-
     /* Input assembly */
     input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 
@@ -619,6 +654,13 @@ static void vulkan_init_buffers(vk_t* vk)
             vk->context->gpu_properties.limits.minUniformBufferOffsetAlignment,
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
     }
+
+    vulkan_buffer_ring_init(vk->context, &vk->vbo_ring,
+        VULKAN_BUFFER_RING_SIZE, 16, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    vulkan_buffer_ring_init(vk->context, &vk->ubo_ring,
+        VULKAN_BUFFER_RING_SIZE,
+        vk->context->gpu_properties.limits.minUniformBufferOffsetAlignment,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
 }
 
 static void vulkan_deinit_buffers(vk_t* vk)
@@ -631,6 +673,9 @@ static void vulkan_deinit_buffers(vk_t* vk)
         vulkan_buffer_chain_free(
             vk->context->device, &vk->swapchain[i].ubo);
     }
+
+    vulkan_buffer_ring_free(vk->context->device, &vk->vbo_ring, "VBO");
+    vulkan_buffer_ring_free(vk->context->device, &vk->ubo_ring, "UBO");
 }
 
 static void vulkan_init_descriptor_pool(vk_t* vk)
@@ -653,6 +698,18 @@ static void vulkan_init_descriptor_pool(vk_t* vk)
 static void vulkan_deinit_descriptor_pool(vk_t* vk)
 {
     unsigned i;
+    uint64_t sets = 0;
+
+    for (i = 0; i < vk->num_swapchain_images; i++)
+        sets += vk->swapchain[i].descriptor_manager.stats.allocs;
+    if (vk->draw_stats.frames)
+        RARCH_LOG("[Vulkan]: %.2f composited draws and %.2f descriptor sets per frame over %llu frames.\n",
+            (double)vk->draw_stats.draws / vk->draw_stats.frames,
+            (double)sets / vk->draw_stats.frames,
+            (unsigned long long)vk->draw_stats.frames);
+    /* Descriptor managers are per swapchain, so are these. */
+    memset(&vk->draw_stats, 0, sizeof(vk->draw_stats));
+
     for (i = 0; i < vk->num_swapchain_images; i++)
         vulkan_destroy_descriptor_manager(
             vk->context->device,
@@ -733,6 +790,11 @@ static void vulkan_deinit_command_buffers(vk_t* vk)
 
 static void vulkan_deinit_pipeline_layout(vk_t* vk)
 {
+    unsigned i;
+    for (i = 0; i < 2; i++)
+        vkDestroyDescriptorUpdateTemplate(vk->context->device,
+            vk->pipelines.quad_templates[i], NULL);
+
     vkDestroyPipelineLayout(vk->context->device,
         vk->pipelines.layout, NULL);
     vkDestroyDescriptorSetLayout(vk->context->device,
@@ -840,6 +902,25 @@ static void vulkan_set_hdr10(vk_t* vk, bool hdr10)
 }
 #endif /* VULKAN_HDR_SWAPCHAIN */
 
+static void vulkan_filter_chain_fill_info(vk_t* vk,
+    struct vulkan_filter_chain_create_info* info)
+{
+    info->device = vk->context->device;
+    info->gpu = vk->context->gpu;
+    info->memory_properties = &vk->context->memory_properties;
+    info->pipeline_cache = vk->pipelines.cache;
+    info->queue = vk->context->queue;
+    info->command_pool = vk->swapchain[vk->context->current_frame_index].cmd_pool;
+    info->num_passes = 0;
+    info->original_format = vk->tex_fmt;
+    info->max_input_size.width = vk->tex_w;
+    info->max_input_size.height = vk->tex_h;
+    info->swapchain.viewport = vk->vk_vp;
+    info->swapchain.format = vk->context->swapchain_format;
+    info->swapchain.render_pass = vk->render_pass;
+    info->swapchain.num_indices = vk->context->num_swapchain_images;
+}
+
 static bool vulkan_init_default_filter_chain(vk_t* vk)
 {
     struct vulkan_filter_chain_create_info info;
@@ -847,20 +928,7 @@ static bool vulkan_init_default_filter_chain(vk_t* vk)
     if (!vk->context)
         return false;
 
-    info.device = vk->context->device;
-    info.gpu = vk->context->gpu;
-    info.memory_properties = &vk->context->memory_properties;
-    info.pipeline_cache = vk->pipelines.cache;
-    info.queue = vk->context->queue;
-    info.command_pool = vk->swapchain[vk->context->current_frame_index].cmd_pool;
-    info.num_passes = 0;
-    info.original_format = vk->tex_fmt;
-    info.max_input_size.width = vk->tex_w;
-    info.max_input_size.height = vk->tex_h;
-    info.swapchain.viewport = vk->vk_vp;
-    info.swapchain.format = vk->context->swapchain_format;
-    info.swapchain.render_pass = vk->render_pass;
-    info.swapchain.num_indices = vk->context->num_swapchain_images;
+    vulkan_filter_chain_fill_info(vk, &info);
 
     vk->filter_chain = vulkan_filter_chain_create_default(
         &info,
@@ -909,7 +977,186 @@ static bool vulkan_init_filter_chain(vk_t* vk)
     return vulkan_init_default_filter_chain(vk);
 }
 
-static void vulkan_init_resources(vk_t* vk)
+static void vulkan_warmup_run(void* data)
+{
+    vk_t* vk = (vk_t*)data;
+    unsigned phase;
+
+    thread_policy_enter(THREAD_ROLE_WORKER);
+
+    phase = startup_phase_begin("vulkan_init_pipelines");
+    vulkan_init_pipelines(vk);
+    startup_phase_end(phase);
+
+    phase = startup_phase_begin("vulkan_filter_chain_create_default");
+    vk->warmup.filter_chain_ok = vulkan_init_filter_chain(vk);
+    startup_phase_end(phase);
+
+    thread_policy_leave();
+}
+
+/* Joins the warm-up worker. Everything touching vk->pipelines or
+ * vk->filter_chain has to go through here first. */
+static bool vulkan_warmup_wait(vk_t* vk)
+{
+    if (vk->warmup.thread)
+    {
+        unsigned phase = startup_phase_begin("vulkan_warmup_wait");
+        sthread_join(vk->warmup.thread);
+        vk->warmup.thread = NULL;
+
+        startup_phase_end(phase);
+
+        if (!vk->warmup.filter_chain_ok)
+            RARCH_ERR("[Vulkan]: Failed to init filter chain.\n");
+    }
+
+    return vk->warmup.filter_chain_ok;
+}
+
+struct vk_filter_chain_job
+{
+    struct vulkan_filter_chain_create_info info;
+    enum glslang_filter_chain_filter filter;
+    vulkan_filter_chain_t* chain;
+    slock_t* lock;
+    bool done;
+};
+
+static void vulkan_filter_chain_job_run(void* data)
+{
+    struct vk_filter_chain_job* job = (struct vk_filter_chain_job*)data;
+    vulkan_filter_chain_t* chain;
+
+    thread_policy_enter(THREAD_ROLE_WORKER);
+    chain = vulkan_filter_chain_create_default(&job->info, job->filter);
+    thread_policy_leave();
+
+    slock_lock(job->lock);
+    job->chain = chain;
+    job->done = true;
+    slock_unlock(job->lock);
+}
+
+static void vulkan_filter_chain_job_free(vk_t* vk)
+{
+    struct vk_filter_chain_job* job = vk->filter_swap.job;
+
+    if (vk->filter_swap.thread)
+        sthread_join(vk->filter_swap.thread);
+    vk->filter_swap.thread = NULL;
+    vk->filter_swap.job = NULL;
+
+    if (!job)
+        return;
+    if (job->chain)
+        vulkan_filter_chain_free(job->chain);
+    slock_free(job->lock);
+    free(job);
+}
+
+/* Builds a replacement filter chain for the current settings on a
+ * worker thread, the running chain keeps presenting meanwhile. */
+static void vulkan_filter_chain_rebuild_async(vk_t* vk)
+{
+    struct vk_filter_chain_job* job;
+
+    if (!vk->context || !vulkan_warmup_wait(vk))
+        return;
+
+    if (vk->filter_swap.job)
+    {
+        vk->filter_swap.rebuild = true;
+        return;
+    }
+
+    job = (struct vk_filter_chain_job*)calloc(1, sizeof(*job));
+    if (!job)
+        return;
+
+    vulkan_filter_chain_fill_info(vk, &job->info);
+    job->filter = vk->video.smooth
+        ? GLSLANG_FILTER_CHAIN_LINEAR
+        : GLSLANG_FILTER_CHAIN_NEAREST;
+    job->lock = slock_new();
+    if (!job->lock)
+    {
+        free(job);
+        return;
+    }
+
+    vk->filter_swap.job = job;
+    vk->filter_swap.rebuild = false;
+    vk->filter_swap.thread = sthread_create(vulkan_filter_chain_job_run, job);
+
+    /* No worker, build inline and swap on the next frame. */
+    if (!vk->filter_swap.thread)
+        vulkan_filter_chain_job_run(job);
+}
+
+/* Swaps in a finished chain and returns the one it replaced, which
+ * must be retired after the new chain has seen this frame's sync index. */
+static vulkan_filter_chain_t* vulkan_filter_chain_poll_swap(vk_t* vk)
+{
+    bool done;
+    vulkan_filter_chain_t* old;
+    vulkan_filter_chain_t* chain;
+    struct vulkan_filter_chain_swapchain_info built;
+    struct vk_filter_chain_job* job = vk->filter_swap.job;
+
+    if (!job)
+        return NULL;
+
+    slock_lock(job->lock);
+    done = job->done;
+    slock_unlock(job->lock);
+
+    if (!done)
+        return NULL;
+
+    chain = job->chain;
+    built = job->info.swapchain;
+    job->chain = NULL;
+    vulkan_filter_chain_job_free(vk);
+
+    if (!chain)
+    {
+        RARCH_LOG("[Vulkan]: Failed to rebuild filter chain, keeping the current one.\n");
+        return NULL;
+    }
+
+    /* The swapchain may have been recreated while the worker ran. */
+    if (built.format != vk->context->swapchain_format
+        || built.render_pass != vk->render_pass
+        || built.num_indices != vk->context->num_swapchain_images)
+    {
+        struct vulkan_filter_chain_swapchain_info info;
+
+        info.viewport = vk->vk_vp;
+        info.format = vk->context->swapchain_format;
+        info.render_pass = vk->render_pass;
+        info.num_indices = vk->context->num_swapchain_images;
+
+        if (!vulkan_filter_chain_update_swapchain_info(chain, &info))
+        {
+            RARCH_LOG("[Vulkan]: Rebuilt filter chain does not fit the swapchain, keeping the current one.\n");
+            vulkan_filter_chain_free(chain);
+            return NULL;
+        }
+    }
+
+    old = (vulkan_filter_chain_t*)vk->filter_chain;
+    vk->filter_chain = chain;
+
+    if (vk->filter_swap.rebuild)
+        vulkan_filter_chain_rebuild_async(vk);
+
+    return old;
+}
+
+/* With defer_pipelines the caller builds the pipelines itself,
+ * the layout they need is still created here. */
+static void vulkan_init_resources(vk_t* vk, bool defer_pipelines)
 {
     if (!vk->context)
         return;
@@ -917,7 +1164,9 @@ static void vulkan_init_resources(vk_t* vk)
     vk->num_swapchain_images = vk->context->num_swapchain_images;
 
     vulkan_init_framebuffers(vk);
-    vulkan_init_pipelines(vk);
+    vulkan_init_pipeline_layout(vk);
+    if (!defer_pipelines)
+        vulkan_init_pipelines(vk);
     vulkan_init_descriptor_pool(vk);
     vulkan_init_textures(vk);
     vulkan_init_buffers(vk);
@@ -954,6 +1203,7 @@ static void vulkan_init_static_resources(vk_t* vk)
     vk->display.blank_texture = vulkan_create_texture(vk, NULL,
         4, 4, VK_FORMAT_B8G8R8A8_UNORM,
         blank, NULL, VULKAN_TEXTURE_STATIC);
+    vk->display.glyphs = vulkan_create_glyph_atlas(vk);
 }
 
 static void vulkan_deinit_static_resources(vk_t* vk)
@@ -964,6 +1214,10 @@ static void vulkan_deinit_static_resources(vk_t* vk)
     vulkan_destroy_texture(
         vk->context->device,
         &vk->display.blank_texture);
+    vulkan_destroy_texture(
+        vk->context->device,
+        &vk->display.glyphs);
+    vulkan_batch_free(vk);
 
     vkDestroyCommandPool(vk->context->device,
         vk->staging_pool, NULL);
@@ -1010,6 +1264,7 @@ static void vulkan_free(void* data)
 
     if (vk->context && vk->context->device)
     {
+        vulkan_warmup_wait(vk);
         slock_lock(vk->context->queue_lock);
         vkQueueWaitIdle(vk->context->queue);
         slock_unlock(vk->context->queue_lock);
@@ -1020,6 +1275,7 @@ static void vulkan_free(void* data)
 
         vulkan_deinit_static_resources(vk);
 
+        vulkan_filter_chain_job_free(vk);
         if (vk->filter_chain)
             vulkan_filter_chain_free((vulkan_filter_chain_t*)vk->filter_chain);
 
@@ -1060,6 +1316,7 @@ static void vulkan_set_image(void* handle,
 
     vk->hw.image = image;
     vk->hw.num_semaphores = num_semaphores;
+    vk->hw.wait_value = 0;
 
     if (num_semaphores > 0)
     {
@@ -1087,6 +1344,18 @@ static void vulkan_set_image(void* handle,
     }
 }
 
+static void vulkan_set_image_timeline(void* handle,
+    const struct retro_vulkan_image* image,
+    VkSemaphore timeline,
+    uint64_t value,
+    uint32_t src_queue_family)
+{
+    vk_t* vk = (vk_t*)handle;
+
+    vulkan_set_image(handle, image, 1, &timeline, src_queue_family);
+    vk->hw.wait_value = value;
+}
+
 static void vulkan_wait_sync_index(void* handle)
 {
     (void)handle;
@@ -1119,13 +1388,13 @@ static void vulkan_set_command_buffers(void* handle, uint32_t num_cmd,
 static void vulkan_lock_queue(void* handle)
 {
     vk_t* vk = (vk_t*)handle;
-    slock_lock(vk->context->queue_lock);
+    vulkan_queue_lock(vk->context, VULKAN_QUEUE_HOLDER_CORE);
 }
 
 static void vulkan_unlock_queue(void* handle)
 {
     vk_t* vk = (vk_t*)handle;
-    slock_unlock(vk->context->queue_lock);
+    vulkan_queue_unlock(vk->context, VULKAN_QUEUE_HOLDER_CORE);
 }
 
 static void vulkan_set_signal_semaphore(void* handle, VkSemaphore semaphore)
@@ -1161,14 +1430,51 @@ static void vulkan_init_hw_render(vk_t* vk)
     iface->lock_queue = vulkan_lock_queue;
     iface->unlock_queue = vulkan_unlock_queue;
     iface->set_signal_semaphore = vulkan_set_signal_semaphore;
+    iface->set_image_timeline = vulkan_set_image_timeline;
 
     iface->get_device_proc_addr = vkGetDeviceProcAddr;
     iface->get_instance_proc_addr = vkGetInstanceProcAddr;
 }
 
+/* Streaming stops after this many frames without a read_viewport. */
+#define VULKAN_READBACK_IDLE_FRAMES 120
+
+static bool vulkan_readback_scaler_init(struct scaler_ctx* ctx,
+    unsigned width, unsigned height, enum scaler_pix_fmt in_fmt)
+{
+    if (ctx->in_width == (int)width && ctx->in_height == (int)height
+        && ctx->in_fmt == in_fmt && ctx->direct_pixconv)
+        return true;
+
+    ctx->in_width = width;
+    ctx->in_height = height;
+    ctx->out_width = width;
+    ctx->out_height = height;
+    ctx->in_fmt = in_fmt;
+    ctx->out_fmt = SCALER_FMT_BGR24;
+    ctx->scaler_type = SCALER_TYPE_POINT;
+    return scaler_ctx_gen_filter(ctx);
+}
+
+static void vulkan_set_readback_streamed(vk_t* vk, bool streamed)
+{
+    unsigned i;
+
+    vk->readback.streamed = streamed;
+    vk->readback.idle_frames = 0;
+    if (!streamed)
+        for (i = 0; i < VULKAN_MAX_SWAPCHAIN_IMAGES; i++)
+            vk->readback.fresh[i] = false;
+}
+
 static void vulkan_init_readback(vk_t* vk)
 {
-    return;
+    /* Readback is streamed on demand: the first read_viewport falls
+     * back to a synchronous copy and turns streaming on, after which
+     * every frame copies the backbuffer into the staging buffer of its
+     * frame index. Reads then return the oldest completed copy, which
+     * the acquire of the next frame has already fenced. */
+    vulkan_set_readback_streamed(vk, false);
 }
 
 static void* vulkan_init(const video_info_t* video)
@@ -1181,6 +1487,7 @@ static void* vulkan_init(const video_info_t* video)
     int interval = 0;
     unsigned temp_width = 0;
     unsigned temp_height = 0;
+    unsigned phase;
     const gfx_ctx_driver_t* ctx_driver = NULL;
     settings_t* settings = config_get_ptr();
     vk_t* vk = (vk_t*)calloc(1, sizeof(*vk));
@@ -1296,13 +1603,24 @@ static void* vulkan_init(const video_info_t* video)
 #endif /* VULKAN_HDR_SWAPCHAIN */
 
     vulkan_init_hw_render(vk);
+
+    phase = startup_phase_begin("vulkan_init_static_resources");
     vulkan_init_static_resources(vk);
-    vulkan_init_resources(vk);
+    startup_phase_end(phase);
 
-    if (!vulkan_init_filter_chain(vk))
+    phase = startup_phase_begin("vulkan_init_resources");
+    vulkan_init_resources(vk, true);
+    startup_phase_end(phase);
+
+    /* The device and swapchain are ready, which is all the core needs
+     * to start up. Pipelines and the filter chain only matter once the
+     * first frame is presented, so build them in the meantime. */
+    vk->warmup.thread = sthread_create(vulkan_warmup_run, vk);
+    if (!vk->warmup.thread)
     {
-        RARCH_ERR("[Vulkan]: Failed to init filter chain.\n");
-        goto error;
+        vulkan_warmup_run(vk);
+        if (!vulkan_warmup_wait(vk))
+            goto error;
     }
 
     vulkan_init_readback(vk);
@@ -1330,12 +1648,13 @@ static void vulkan_check_swapchain(vk_t* vk)
 {
     if (vk->context->invalid_swapchain)
     {
+        vulkan_warmup_wait(vk);
         slock_lock(vk->context->queue_lock);
         vkQueueWaitIdle(vk->context->queue);
         slock_unlock(vk->context->queue_lock);
 
         vulkan_deinit_resources(vk);
-        vulkan_init_resources(vk);
+        vulkan_init_resources(vk, false);
         vk->context->invalid_swapchain = false;
 
         vulkan_update_filter_chain(vk);
@@ -1362,6 +1681,10 @@ static void vulkan_set_nonblock_state(void* data, bool state,
         vk->ctx_driver->swap_interval(vk->ctx_data, interval);
     }
 
+    /* The present mode also depends on video_vsync, which the
+     * context does not track, so always go through set_resize. */
+    vk->should_resize = true;
+
     /* Changing vsync might require recreating the swapchain,
      * which means new VkImages to render into. */
     vulkan_check_swapchain(vk);
@@ -1413,6 +1736,8 @@ static bool vulkan_set_shader(void* data,
     if (!vk)
         return false;
 
+    vulkan_warmup_wait(vk);
+
     // no shader bs is allowed here
     RARCH_ERR("[Vulkan]: Failed to create filter chain: \"%s\". Falling back to stock.\n", path);
     vulkan_init_default_filter_chain(vk);
@@ -1599,6 +1924,7 @@ static void vulkan_readback(vk_t* vk)
     region.imageExtent.depth = 1;
 
     staging = &vk->readback.staging[vk->context->current_frame_index];
+    vk->readback.fresh[vk->context->current_frame_index] = true;
     *staging = vulkan_create_texture(vk,
         staging->memory != VK_NULL_HANDLE ? staging : NULL,
         vk->vp.width, vk->vp.height,
@@ -1621,6 +1947,141 @@ static void vulkan_readback(vk_t* vk)
         1, &barrier, 0, NULL, 0, NULL);
 }
 
+/* HUD layout in glyph pixels, which are scaled with the swapchain. */
+#define VULKAN_HUD_MARGIN 4
+#define VULKAN_HUD_LINE 7
+#define VULKAN_HUD_GRAPH 24
+#define VULKAN_HUD_LINES 5
+
+static void vulkan_render_hud_bar(vk_t* vk, struct vk_batch_quad* quad,
+    float bottom, float height, const struct vk_color* color)
+{
+    if (height <= 0.0f)
+        return;
+
+    quad->y = bottom - height;
+    quad->height = height;
+    quad->color = *color;
+    vulkan_batch_quad(vk, vk->display.pipelines[1],
+        &vk->display.blank_texture, vk->samplers.nearest, quad);
+}
+
+/* Draws the plugin's performance HUD in the top left corner of the
+ * backbuffer render pass. Everything goes through the quad batch, so
+ * it costs one draw for the panel and graphs and one for the text. */
+static void vulkan_render_hud(vk_t* vk, const struct retro_perf_hud* hud)
+{
+    unsigned i, scale;
+    char line[64];
+    uint64_t vram_used, vram_budget;
+    float px, py, x, y, graph_ms;
+    struct vk_batch_quad quad;
+    struct video_viewport vp = vk->vp;
+    VkViewport vk_vp = vk->vk_vp;
+    unsigned newest = (hud->head + RETRO_PERF_HUD_HISTORY - 1) % RETRO_PERF_HUD_HISTORY;
+    static const struct vk_color panel = { 0.0f, 0.0f, 0.0f, 0.6f };
+    static const struct vk_color cpu = { 0.3f, 0.6f, 1.0f, 0.9f };
+    static const struct vk_color gpu = { 1.0f, 0.6f, 0.2f, 0.9f };
+    static const struct vk_color text = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+    /* The viewport pass left its own state bound. */
+    vk->tracker.pipeline = VK_NULL_HANDLE;
+    vk->tracker.view = VK_NULL_HANDLE;
+    vk->tracker.sampler = VK_NULL_HANDLE;
+    vk->tracker.use_scissor = false;
+    vk->tracker.dirty |= VULKAN_DIRTY_DYNAMIC_BIT;
+
+    vk->vp.x = 0;
+    vk->vp.y = 0;
+    vk->vp.width = vk->context->swapchain_width;
+    vk->vp.height = vk->context->swapchain_height;
+    vk->vk_vp.x = 0.0f;
+    vk->vk_vp.y = 0.0f;
+    vk->vk_vp.width = (float)vk->vp.width;
+    vk->vk_vp.height = (float)vk->vp.height;
+    vk->vk_vp.minDepth = 0.0f;
+    vk->vk_vp.maxDepth = 1.0f;
+
+    /* One glyph pixel per 360 lines keeps it readable at any size. */
+    scale = MAX(1, vk->vp.height / 360);
+    px = (float)scale / vk->vk_vp.width;
+    py = (float)scale / vk->vk_vp.height;
+
+    quad.tex_x = 0.0f;
+    quad.tex_y = 0.0f;
+    quad.tex_width = 1.0f;
+    quad.tex_height = 1.0f;
+
+    quad.x = VULKAN_HUD_MARGIN * px;
+    quad.y = VULKAN_HUD_MARGIN * py;
+    quad.width = (RETRO_PERF_HUD_HISTORY + 4) * px;
+    quad.height = (VULKAN_HUD_LINES * VULKAN_HUD_LINE + VULKAN_HUD_GRAPH + 4) * py;
+    quad.color = panel;
+    vulkan_batch_quad(vk, vk->display.pipelines[1],
+        &vk->display.blank_texture, vk->samplers.nearest, &quad);
+
+    /* Bars are one glyph pixel wide, the graph tops out at two 60 Hz frames. */
+    graph_ms = 1000.0f / 30.0f;
+    x = (VULKAN_HUD_MARGIN + 2) * px;
+    y = (VULKAN_HUD_MARGIN + 2 + VULKAN_HUD_GRAPH) * py;
+    quad.width = px;
+    for (i = 0; i < RETRO_PERF_HUD_HISTORY; i++, x += px)
+    {
+        unsigned sample = (hud->head + i) % RETRO_PERF_HUD_HISTORY;
+        float cpu_height = MIN(hud->cpu_ms[sample] / graph_ms, 1.0f) * VULKAN_HUD_GRAPH * py;
+        float gpu_height = MIN(hud->gpu_ms[sample] / graph_ms, 1.0f) * VULKAN_HUD_GRAPH * py;
+
+        /* Taller bar first so the shorter one stays visible on top. */
+        quad.x = x;
+        if (cpu_height > gpu_height)
+        {
+            vulkan_render_hud_bar(vk, &quad, y, cpu_height, &cpu);
+            vulkan_render_hud_bar(vk, &quad, y, gpu_height, &gpu);
+        }
+        else
+        {
+            vulkan_render_hud_bar(vk, &quad, y, gpu_height, &gpu);
+            vulkan_render_hud_bar(vk, &quad, y, cpu_height, &cpu);
+        }
+    }
+
+    x = (VULKAN_HUD_MARGIN + 2) * px;
+    y += 2 * py;
+
+    snprintf(line, sizeof(line), "CPU %.1fMS", hud->cpu_ms[newest]);
+    vulkan_batch_text(vk, x, y, scale, line, &cpu);
+    snprintf(line, sizeof(line), "GPU %.1fMS", hud->gpu_ms[newest]);
+    /* Fixed column, so the values don't shift the label around. */
+    vulkan_batch_text(vk, x + 52 * px, y, scale, line, &gpu);
+    y += VULKAN_HUD_LINE * py;
+
+    snprintf(line, sizeof(line), "PRESENT %.1fMS", hud->present_ms);
+    vulkan_batch_text(vk, x, y, scale, line, &text);
+    y += VULKAN_HUD_LINE * py;
+
+    snprintf(line, sizeof(line), "QUEUE %u IN FLIGHT %u",
+        hud->queue_depth, hud->frames_in_flight);
+    vulkan_batch_text(vk, x, y, scale, line, &text);
+    y += VULKAN_HUD_LINE * py;
+
+    snprintf(line, sizeof(line), "RDP CMDS %u", hud->commands);
+    vulkan_batch_text(vk, x, y, scale, line, &text);
+    y += VULKAN_HUD_LINE * py;
+
+    vulkan_get_vram_usage(vk->context, &vram_used, &vram_budget);
+    if (vram_budget)
+        snprintf(line, sizeof(line), "VRAM %u/%uMB",
+            (unsigned)(vram_used >> 20), (unsigned)(vram_budget >> 20));
+    else
+        snprintf(line, sizeof(line), "VRAM %uMB", (unsigned)(vram_used >> 20));
+    vulkan_batch_text(vk, x, y, scale, line, &text);
+
+    vulkan_batch_flush(vk);
+
+    vk->vp = vp;
+    vk->vk_vp = vk_vp;
+}
+
 typedef struct gfx_ctx_mode
 {
     unsigned width;
@@ -1639,7 +2100,12 @@ static bool vulkan_frame(void* data, const void* frame,
     VkRenderPassBeginInfo rp_info;
     VkCommandBufferBeginInfo begin_info;
     VkSemaphore signal_semaphores[2];
+    VkTimelineSemaphoreSubmitInfo timeline_info;
+    uint64_t wait_values[2];
     vk_t* vk = (vk_t*)data;
+    /* The first frame after init waits for the pipeline warm-up. */
+    bool warmed_up = vulkan_warmup_wait(vk);
+    vulkan_filter_chain_t* retired_chain = NULL;
     bool waits_for_semaphores = false;
     settings_t* settings = config_get_ptr();
     unsigned width = settings->uints.window_position_width;
@@ -1662,12 +2128,17 @@ static bool vulkan_frame(void* data, const void* frame,
     struct vk_buffer_chain* buff_chain_vbo = &chain->vbo;
     struct vk_buffer_chain* buff_chain_ubo = &chain->ubo;
 
+    if (!warmed_up)
+        return false;
+
     vk->chain = chain;
     vk->backbuffer = backbuffer;
 
     VK_DESCRIPTOR_MANAGER_RESTART(manager);
     VK_BUFFER_CHAIN_DISCARD(buff_chain_vbo);
     VK_BUFFER_CHAIN_DISCARD(buff_chain_ubo);
+    vulkan_buffer_ring_begin_frame(&vk->vbo_ring, frame_index);
+    vulkan_buffer_ring_begin_frame(&vk->ubo_ring, frame_index);
 
     /* Start recording the command buffer. */
     vk->cmd = chain->cmd;
@@ -1683,6 +2154,7 @@ static bool vulkan_frame(void* data, const void* frame,
 
     vkBeginCommandBuffer(vk->cmd, &begin_info);
 
+    vk->draw_stats.frames++;
     vk->tracker.dirty = 0;
     vk->tracker.scissor.offset.x = 0;
     vk->tracker.scissor.offset.y = 0;
@@ -1692,6 +2164,8 @@ static bool vulkan_frame(void* data, const void* frame,
     vk->tracker.pipeline = VK_NULL_HANDLE;
     vk->tracker.view = VK_NULL_HANDLE;
     vk->tracker.sampler = VK_NULL_HANDLE;
+    vk->tracker.ubo.data = NULL;
+    vk->tracker.ubo_size = 0;
     for (i = 0; i < 16; i++)
         vk->tracker.mvp.data[i] = 0.0f;
 
@@ -1770,9 +2244,15 @@ static bool vulkan_frame(void* data, const void* frame,
         vk->last_valid_index = frame_index;
     }
 
+    /* Pick up a filter chain rebuilt in the background. */
+    retired_chain = vulkan_filter_chain_poll_swap(vk);
+
     /* Notify filter chain about the new sync index. */
     vulkan_filter_chain_notify_sync_index(
         (vulkan_filter_chain_t*)vk->filter_chain, frame_index);
+    if (retired_chain)
+        vulkan_filter_chain_retire(
+            (vulkan_filter_chain_t*)vk->filter_chain, retired_chain);
     vulkan_filter_chain_set_frame_count(
         (vulkan_filter_chain_t*)vk->filter_chain, frame_count);
     vulkan_filter_chain_set_frame_direction(
@@ -1880,6 +2360,8 @@ static bool vulkan_frame(void* data, const void* frame,
     if ((backbuffer->image != VK_NULL_HANDLE)
         && vk->context->has_acquired_swapchain)
     {
+        const struct retro_perf_hud* hud = retro_get_perf_hud();
+
         rp_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
         rp_info.pNext = NULL;
         rp_info.renderPass = vk->render_pass;
@@ -1910,6 +2392,9 @@ static bool vulkan_frame(void* data, const void* frame,
             (vulkan_filter_chain_t*)vk->filter_chain, vk->cmd,
             &vk->vk_vp, vk->mvp.data);
 
+        if (hud)
+            vulkan_render_hud(vk, hud);
+
         /* End the render pass. We're done rendering to backbuffer now. */
         vkCmdEndRenderPass(vk->cmd);
 
@@ -2034,7 +2519,7 @@ static bool vulkan_frame(void* data, const void* frame,
             {
                 struct vk_buffer_range range;
 
-                vulkan_buffer_chain_alloc(vk->context, &vk->chain->vbo, 6 * sizeof(struct vk_vertex), &range);
+                vulkan_buffer_ring_alloc(vk->context, &vk->vbo_ring, &vk->chain->vbo, 6 * sizeof(struct vk_vertex), &range);
 
                 {
                     struct vk_vertex* pv = (struct vk_vertex*)range.data;
@@ -2069,6 +2554,10 @@ static bool vulkan_frame(void* data, const void* frame,
         && vk->context->has_acquired_swapchain
         )
     {
+        if (vk->readback.streamed
+            && ++vk->readback.idle_frames > VULKAN_READBACK_IDLE_FRAMES)
+            vulkan_set_readback_streamed(vk, false);
+
         if (vk->readback.pending || vk->readback.streamed)
         {
             /* We cannot safely read back from an image which
@@ -2210,11 +2699,26 @@ static bool vulkan_frame(void* data, const void* frame,
     }
     submit_info.pSignalSemaphores = submit_info.signalSemaphoreCount ? signal_semaphores : NULL;
 
-    slock_lock(vk->context->queue_lock);
+    if (waits_for_semaphores && vk->hw.wait_value)
+    {
+        /* The timeline is semaphores[0], a swapchain acquire
+         * semaphore after it is binary and ignores its value. */
+        wait_values[0] = vk->hw.wait_value;
+        wait_values[1] = 0;
+        timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_info.pNext = NULL;
+        timeline_info.waitSemaphoreValueCount = submit_info.waitSemaphoreCount;
+        timeline_info.pWaitSemaphoreValues = wait_values;
+        timeline_info.signalSemaphoreValueCount = 0;
+        timeline_info.pSignalSemaphoreValues = NULL;
+        submit_info.pNext = &timeline_info;
+    }
+
+    vulkan_queue_lock(vk->context, VULKAN_QUEUE_HOLDER_FRAME);
     vkQueueSubmit(vk->context->queue, 1,
         &submit_info, vk->context->swapchain_fences[frame_index]);
     vk->context->swapchain_fences_signalled[frame_index] = true;
-    slock_unlock(vk->context->queue_lock);
+    vulkan_queue_unlock(vk->context, VULKAN_QUEUE_HOLDER_FRAME);
 
     if (vk->ctx_driver->swap_buffers)
         vk->ctx_driver->swap_buffers(vk->ctx_data);
@@ -2389,11 +2893,28 @@ static void vulkan_set_aspect_ratio(void* data, unsigned aspect_ratio_idx)
     vk->should_resize = true;
 }
 
+static void vulkan_set_filtering(void* data, unsigned index,
+    bool smooth, bool ctx_scaling)
+{
+    vk_t* vk = (vk_t*)data;
+
+    if (!vk || vk->video.smooth == smooth)
+        return;
+
+    vk->video.smooth = smooth;
+    vulkan_filter_chain_rebuild_async(vk);
+}
+
 static void vulkan_apply_state_changes(void* data)
 {
     vk_t* vk = (vk_t*)data;
-    if (vk)
-        vk->should_resize = true;
+    settings_t* settings = config_get_ptr();
+
+    if (!vk)
+        return;
+
+    vk->keep_aspect = settings->bools.video_force_aspect;
+    vk->should_resize = true;
 }
 
 static void vulkan_show_mouse(void* data, bool state)
@@ -2407,7 +2928,7 @@ static void vulkan_show_mouse(void* data, bool state)
 static struct video_shader* vulkan_get_current_shader(void* data)
 {
     vk_t* vk = (vk_t*)data;
-    if (!vk || !vk->filter_chain)
+    if (!vk || !vulkan_warmup_wait(vk))
         return NULL;
 
     return vulkan_filter_chain_get_preset((vulkan_filter_chain_t*)vk->filter_chain);
@@ -2482,7 +3003,6 @@ static void vulkan_set_texture_frame(void* data,
     float alpha)
 {
     unsigned y, stride;
-    uint8_t* ptr = NULL;
     uint8_t* dst = NULL;
     const uint8_t* src = NULL;
     vk_t* vk = (vk_t*)data;
@@ -2512,10 +3032,7 @@ static void vulkan_set_texture_frame(void* data,
         NULL, rgb32 ? NULL : &br_swizzle,
         texture_optimal->memory ? VULKAN_TEXTURE_STAGING : VULKAN_TEXTURE_STREAMED);
 
-    vkMapMemory(vk->context->device, texture->memory,
-        texture->offset, texture->size, 0, (void**)&ptr);
-
-    dst = ptr;
+    dst = (uint8_t*)texture->allocation.mapped + texture->offset;
     src = (const uint8_t*)frame;
     stride = (rgb32 ? sizeof(uint32_t) : sizeof(uint16_t)) * width;
 
@@ -2539,7 +3056,6 @@ static void vulkan_set_texture_frame(void* data,
         VULKAN_SYNC_TEXTURE_TO_GPU_COND_PTR(vk, texture);
     }
 
-    vkUnmapMemory(vk->context->device, texture->memory);
     vk->menu.dirty[index] = true;
 }
 
@@ -2679,7 +3195,7 @@ static const video_poke_interface_t vulkan_poke_interface = {
    vulkan_unload_texture,
    vulkan_set_video_mode,
    vulkan_get_refresh_rate, /* get_refresh_rate */
-   NULL,
+   vulkan_set_filtering,
    vulkan_get_video_output_size,
    vulkan_get_video_output_prev,
    vulkan_get_video_output_next,
@@ -2754,20 +3270,38 @@ static bool vulkan_read_viewport(void* data, uint8_t* buffer, bool is_idle)
 
     staging = &vk->readback.staging[vk->context->current_frame_index];
 
+    /* A streamed copy is only usable if it was taken since streaming
+     * started and still matches the viewport, otherwise pay for one
+     * synchronous readback. */
+    if (vk->readback.streamed
+        && (!vk->readback.fresh[vk->context->current_frame_index]
+            || staging->memory == VK_NULL_HANDLE
+            || staging->width != vk->vp.width
+            || staging->height != vk->vp.height))
+        vulkan_set_readback_streamed(vk, false);
+
     if (vk->readback.streamed)
     {
         const uint8_t* src = NULL;
         struct scaler_ctx* ctx = NULL;
 
+        vk->readback.idle_frames = 0;
+
         switch (vk->context->swapchain_format)
         {
         case VK_FORMAT_R8G8B8A8_UNORM:
         case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
             ctx = &vk->readback.scaler_rgb;
+            if (!vulkan_readback_scaler_init(ctx,
+                vk->vp.width, vk->vp.height, SCALER_FMT_ABGR8888))
+                ctx = NULL;
             break;
 
         case VK_FORMAT_B8G8R8A8_UNORM:
             ctx = &vk->readback.scaler_bgr;
+            if (!vulkan_readback_scaler_init(ctx,
+                vk->vp.width, vk->vp.height, SCALER_FMT_ARGB8888))
+                ctx = NULL;
             break;
 
         default:
@@ -2775,29 +3309,21 @@ static bool vulkan_read_viewport(void* data, uint8_t* buffer, bool is_idle)
             break;
         }
 
-        if (ctx)
-        {
-            if (staging->memory == VK_NULL_HANDLE)
-                return false;
-
-            buffer += 3 * (vk->vp.height - 1) * vk->vp.width;
-            vkMapMemory(vk->context->device, staging->memory,
-                staging->offset, staging->size, 0, (void**)&src);
+        if (!ctx)
+            return false;
 
-            if (staging->need_manual_cache_management
-                && staging->memory != VK_NULL_HANDLE)
-                VULKAN_SYNC_TEXTURE_TO_CPU(vk->context->device, staging->memory);
+        buffer += 3 * (vk->vp.height - 1) * vk->vp.width;
+        src = (uint8_t*)staging->allocation.mapped + staging->offset;
 
-            ctx->in_stride = staging->stride;
-            ctx->out_stride = -(int)vk->vp.width * 3;
-            scaler_ctx_scale_direct(ctx, buffer, src);
+        if (staging->need_manual_cache_management)
+            VULKAN_SYNC_TEXTURE_TO_CPU(vk->context->device, staging->memory);
 
-            vkUnmapMemory(vk->context->device, staging->memory);
-        }
+        ctx->in_stride = staging->stride;
+        ctx->out_stride = -(int)vk->vp.width * 3;
+        scaler_ctx_scale_direct(ctx, buffer, src);
     }
     else
     {
-        /* Synchronous path only for now. */
         /* TODO: How will we deal with format conversion?
          * For now, take the simplest route and use image blitting
          * with conversion. */
@@ -2869,8 +3395,10 @@ static bool vulkan_read_viewport(void* data, uint8_t* buffer, bool is_idle)
                 break;
             }
         }
-        vulkan_destroy_texture(
-            vk->context->device, staging);
+
+        /* Somebody is reading frames, keep the staging buffers and
+         * stream the following frames instead of stalling again. */
+        vulkan_set_readback_streamed(vk, true);
     }
     return true;
 }
@@ -2952,8 +3480,8 @@ static void vulkan_render_overlay(vk_t* vk, unsigned width,
         struct vk_draw_triangles call;
         struct vk_buffer_range range;
 
-        if (!vulkan_buffer_chain_alloc(vk->context, &vk->chain->vbo,
-            4 * sizeof(struct vk_vertex), &range))
+        if (!vulkan_buffer_ring_alloc(vk->context, &vk->vbo_ring,
+            &vk->chain->vbo, 4 * sizeof(struct vk_vertex), &range))
             break;
 
         memcpy(range.data, &vk->overlay.vertex[i * 4],
@@ -24,20 +24,33 @@
 #include "../config.h"
 #include "driver.h"
 #include "video_driver.h"
+#include "startup_profile.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <Windows.h>
 
 extern bool parallel_retro_init_vulkan(void);
 
 retro_log_printf_t log_cb;
+static const struct retro_perf_hud* perf_hud;
 
 void retro_video_refresh(const void* data, unsigned width, unsigned height, size_t pitch)
 {
     video_driver_frame(data, width, height, pitch);
 }
 
+void retro_set_perf_hud(const struct retro_perf_hud* hud)
+{
+    perf_hud = hud;
+}
+
+const struct retro_perf_hud* retro_get_perf_hud(void)
+{
+    return perf_hud;
+}
+
 void retro_log(enum retro_log_level level, const char* fmt, ...)
 {
 	va_list va;
@@ -75,6 +88,7 @@ static bool core_unload_game(void)
 
 static bool core_deinit()
 {
+    unsigned phase;
     video_driver_state_t
         * video_st = video_state_get_ptr();
 
@@ -82,7 +96,9 @@ static bool core_deinit()
 
     video_driver_set_cached_frame_ptr(NULL);
 
+    phase = startup_phase_begin("driver_uninit");
     driver_uninit(DRIVERS_CMD_ALL);
+    startup_phase_end(phase);
 }
 
 bool retro_init(bool fs, unsigned width, unsigned height)
@@ -95,6 +111,7 @@ bool retro_init(bool fs, unsigned width, unsigned height)
     rsettings->uints.window_position_width = width;
     rsettings->bools.video_fullscreen = fs;
     rsettings->bools.video_vsync = settings[KEY_VSYNC].val;
+    rsettings->uints.video_max_swapchain_images = settings[KEY_SWAPCHAIN_IMAGES].val;
     // RDP::window_integerscale = settings[KEY_INTEGER].val;
 
 #if defined(DEBUG) && defined(HAVE_DRMINGW)
@@ -102,6 +119,8 @@ bool retro_init(bool fs, unsigned width, unsigned height)
 #endif
     bool verbosity_enabled = false;
     bool           init_failed = false;
+    unsigned phase = startup_phase_begin("retro_init");
+    unsigned sub_phase;
     video_driver_state_t* video_st = video_state_get_ptr();
     video_st->active = true;
 
@@ -109,7 +128,9 @@ bool retro_init(bool fs, unsigned width, unsigned height)
         "video driver", verbosity_enabled))
         retroarch_fail(1, "video_driver_find_driver()");
 
+    sub_phase = startup_phase_begin("core_init");
     init_failed = core_init();
+    startup_phase_end(sub_phase);
 
     /* Handle core initialization failure */
     if (init_failed)
@@ -118,17 +139,43 @@ bool retro_init(bool fs, unsigned width, unsigned height)
         goto error;
     }
 
+    sub_phase = startup_phase_begin("drivers_init");
     drivers_init(rsettings, DRIVERS_CMD_ALL, verbosity_enabled);
+    startup_phase_end(sub_phase);
+    startup_phase_end(phase);
     return true;
 
 error:
     core_deinit();
+    startup_phase_end(phase);
     return false;
 }
 
 void retro_deinit(void)
 {
+    unsigned phase = startup_phase_begin("retro_deinit");
     core_deinit();
+    startup_phase_end(phase);
+}
+
+void retro_apply_swapchain(void)
+{
+    settings_t* rsettings = config_get_ptr();
+
+    rsettings->bools.video_vsync = settings[KEY_VSYNC].val;
+    video_driver_set_nonblock_state(!rsettings->bools.video_vsync);
+}
+
+void retro_apply_presentation(void)
+{
+    settings_t* rsettings = config_get_ptr();
+
+    rsettings->bools.video_force_aspect = settings[KEY_INTEGER].val;
+
+    /* Filter changes rebuild the filter chain in the background and
+     * swap it in at a frame boundary, the rest only needs a resize. */
+    video_driver_set_filtering(1, rsettings->bools.video_smooth, false);
+    video_driver_apply_state_changes();
 }
 
 void retro_reinit()
@@ -136,6 +183,34 @@ void retro_reinit()
     video_driver_reinit();
 }
 
+bool retro_read_screen(void** dest, long* width, long* height)
+{
+    struct video_viewport vp = { 0 };
+    uint8_t* buffer;
+
+    *dest = NULL;
+    *width = 0;
+    *height = 0;
+
+    if (!video_driver_get_viewport_info(&vp) || !vp.width || !vp.height)
+        return false;
+
+    buffer = (uint8_t*)malloc(vp.width * vp.height * 3);
+    if (!buffer)
+        return false;
+
+    if (!video_driver_read_viewport(buffer, false))
+    {
+        free(buffer);
+        return false;
+    }
+
+    *dest = buffer;
+    *width = vp.width;
+    *height = vp.height;
+    return true;
+}
+
 static settings_t config_st = { 0 };
 
 settings_t* config_get_ptr(void)
@@ -64,6 +64,13 @@ typedef void (*retro_vulkan_wait_sync_index_t)(void* handle);
 typedef void (*retro_vulkan_lock_queue_t)(void* handle);
 typedef void (*retro_vulkan_unlock_queue_t)(void* handle);
 typedef void (*retro_vulkan_set_signal_semaphore_t)(void* handle, VkSemaphore semaphore);
+/* Like set_image with one semaphore, but a timeline one which the frontend
+ * waits to reach value. Needs timelineSemaphore enabled on the device. */
+typedef void (*retro_vulkan_set_image_timeline_t)(void* handle,
+    const struct retro_vulkan_image* image,
+    VkSemaphore timeline,
+    uint64_t value,
+    uint32_t src_queue_family);
 
 typedef const VkApplicationInfo* (*retro_vulkan_get_application_info_t)(void);
 
@@ -136,6 +143,7 @@ struct retro_hw_render_interface_vulkan
     retro_vulkan_lock_queue_t lock_queue;
     retro_vulkan_unlock_queue_t unlock_queue;
     retro_vulkan_set_signal_semaphore_t set_signal_semaphore;
+    retro_vulkan_set_image_timeline_t set_image_timeline;
 };
 
 struct texture_image
@@ -217,6 +225,22 @@ inline bool string_is_equal(const char* a, const char* b)
 
 #define string_is_equal_fast(a, b, size)     (memcmp(a, b, size) == 0)
 
+/* Samples kept for the HUD graphs. */
+#define RETRO_PERF_HUD_HISTORY 96
+
+/* Filled by the plugin, drawn on top of every presented frame. */
+struct retro_perf_hud
+{
+    /* Per frame history, the newest sample is just before head. */
+    float cpu_ms[RETRO_PERF_HUD_HISTORY];
+    float gpu_ms[RETRO_PERF_HUD_HISTORY];
+    unsigned head;
+    float present_ms;
+    unsigned queue_depth;
+    unsigned frames_in_flight;
+    unsigned commands;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -224,6 +248,18 @@ extern "C" {
     bool retro_init(bool fs, unsigned width, unsigned height);
     void retro_deinit(void);
     void retro_reinit(void);
+    /* Applies presentation-only settings to the running driver. */
+    void retro_apply_presentation(void);
+    /* Recreates the swapchain for the current vsync setting. */
+    void retro_apply_swapchain(void);
+    /* Mallocs *dest and fills it with the last presented frame as
+     * bottom-up BGR24. After the first call frames are read back
+     * without stalling until reads stop for a while. */
+    bool retro_read_screen(void** dest, long* width, long* height);
+    /* Shows hud on the following frames, NULL hides it. The pointer
+     * is read while presenting, on the thread calling retro_video_refresh. */
+    void retro_set_perf_hud(const struct retro_perf_hud* hud);
+    const struct retro_perf_hud* retro_get_perf_hud(void);
 
     void retroarch_fail(int num, const char* err, ...);
 
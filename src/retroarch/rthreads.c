@@ -26,6 +26,10 @@
 #endif
 #endif
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -41,10 +45,9 @@
 #else
 #define WIN32_LEAN_AND_MEAN
 #ifndef _WIN32_WINNT
-#define _WIN32_WINNT 0x0500 /*_WIN32_WINNT_WIN2K */
+#define _WIN32_WINNT 0x0600 /*_WIN32_WINNT_VISTA, for SRW locks and InitOnce */
 #endif
 #include <windows.h>
-#include <mmsystem.h>
 #endif
 #elif defined(GEKKO)
 #include "gx_pthread.h"
@@ -59,6 +62,27 @@
 #include <sys/time.h>
 #endif
 
+/* slock/scond are a plain mutex word and sequence counter on top of
+ * futex (Linux) or WaitOnAddress (Windows), which keeps the uncontended
+ * paths to a single atomic and never allocates kernel objects. */
+#if defined(USE_WIN32_THREADS) || defined(__linux__)
+#define HAVE_FUTEX_LOCKS
+#endif
+
+#ifdef HAVE_FUTEX_LOCKS
+#ifdef USE_WIN32_THREADS
+typedef LONG rthreads_atomic_t;
+#else
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+typedef int rthreads_atomic_t;
+#endif
+#endif
+
 #ifdef __MACH__
 #include <mach/clock.h>
 #include <mach/mach.h>
@@ -82,54 +106,168 @@ struct sthread
 
 struct slock
 {
-#ifdef USE_WIN32_THREADS
-    CRITICAL_SECTION lock;
+#ifdef HAVE_FUTEX_LOCKS
+    /* 0 unlocked, 1 locked, 2 locked with possible sleepers. */
+    rthreads_atomic_t state;
+    /* Contended acquisitions, updated by the new owner under the lock. */
+    unsigned spun;
+    unsigned slept;
 #else
     pthread_mutex_t lock;
 #endif
 };
 
-#ifdef USE_WIN32_THREADS
-/* The syntax we'll use is mind-bending unless we use a struct. Plus, we might want to store more info later */
-/* This will be used as a linked list immplementing a queue of waiting threads */
-struct queue_entry
+struct scond
 {
-    struct queue_entry* next;
-};
+#ifdef HAVE_FUTEX_LOCKS
+    /* Bumped by every signal, waiters sleep until it moves. */
+    rthreads_atomic_t seq;
+    /* Lets signals skip the wake call when nobody waits. */
+    rthreads_atomic_t waiters;
+#else
+    pthread_cond_t cond;
 #endif
+};
+
+#ifdef HAVE_FUTEX_LOCKS
+/* Critical sections guarded by slock in the Vulkan driver are a handful
+ * of loads and stores, so a contended lock is usually free again within
+ * a few hundred cycles. Spin that long before paying for a sleep. */
+#define SLOCK_SPIN_COUNT 256
 
-struct scond
-{
 #ifdef USE_WIN32_THREADS
-    /* With this implementation of scond, we don't have any way of waking
-     * (or even identifying) specific threads
-     * But we need to wake them in the order indicated by the queue.
-     * This potato token will get get passed around every waiter.
-     * The bearer can test whether he's next, and hold onto the potato if he is.
-     * When he's done he can then put it back into play to progress
-     * the queue further */
-    HANDLE hot_potato;
+#define rthreads_cas(ptr, expected, desired) InterlockedCompareExchange((ptr), (desired), (expected))
+#define rthreads_xchg(ptr, value) InterlockedExchange((ptr), (value))
+#define rthreads_add(ptr, value) InterlockedExchangeAdd((ptr), (value))
+#define rthreads_load(ptr) (*(volatile rthreads_atomic_t*)(ptr))
+#define rthreads_pause() YieldProcessor()
 
-    /* The primary signalled event. Hot potatoes are passed until this is set. */
-    HANDLE event;
+typedef BOOL(WINAPI* wait_on_address_t)(volatile VOID*, PVOID, SIZE_T, DWORD);
+typedef VOID(WINAPI* wake_by_address_t)(PVOID);
 
-    /* the head of the queue; NULL if queue is empty */
-    struct queue_entry* head;
+static wait_on_address_t wait_on_address;
+static wake_by_address_t wake_by_address_single;
+static wake_by_address_t wake_by_address_all;
 
-    /* equivalent to the queue length */
-    int waiters;
+/* Without WaitOnAddress (before Windows 8) waits park on one process
+ * wide condition variable instead, every wake rechecks its address. */
+static SRWLOCK futex_park_lock = SRWLOCK_INIT;
+static CONDITION_VARIABLE futex_park_cond = CONDITION_VARIABLE_INIT;
 
-    /* how many waiters in the queue have been conceptually wakened by signals
-     * (even if we haven't managed to actually wake them yet) */
-    int wakens;
+static BOOL CALLBACK futex_resolve(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+    HMODULE synch = GetModuleHandleA("api-ms-win-core-synch-l1-2-0.dll");
+    if (!synch)
+        synch = GetModuleHandleA("kernelbase.dll");
+    if (synch)
+    {
+        wait_on_address = (wait_on_address_t)GetProcAddress(synch, "WaitOnAddress");
+        wake_by_address_single = (wake_by_address_t)GetProcAddress(synch, "WakeByAddressSingle");
+        wake_by_address_all = (wake_by_address_t)GetProcAddress(synch, "WakeByAddressAll");
+    }
+    if (!wait_on_address || !wake_by_address_single || !wake_by_address_all)
+        wait_on_address = NULL;
+    return TRUE;
+}
 
-    /* used to control access to this scond, in case the user fails */
-    CRITICAL_SECTION cs;
+static INIT_ONCE futex_once = INIT_ONCE_STATIC_INIT;
 
+/* Sleeps while *ptr == expected, returns false on timeout. Like a futex
+ * it may return early, callers re-check their condition. */
+static bool futex_wait(rthreads_atomic_t* ptr, rthreads_atomic_t expected, int64_t timeout_us)
+{
+    DWORD ms = timeout_us < 0 ? INFINITE : (DWORD)((timeout_us + 999) / 1000);
+    bool woken = true;
+
+    InitOnceExecuteOnce(&futex_once, futex_resolve, NULL, NULL);
+    if (wait_on_address)
+    {
+        if (!wait_on_address(ptr, &expected, sizeof(expected), ms))
+            woken = GetLastError() != ERROR_TIMEOUT;
+        return woken;
+    }
+
+    AcquireSRWLockExclusive(&futex_park_lock);
+    if (rthreads_load(ptr) == expected
+        && !SleepConditionVariableSRW(&futex_park_cond, &futex_park_lock, ms, 0))
+        woken = GetLastError() != ERROR_TIMEOUT;
+    ReleaseSRWLockExclusive(&futex_park_lock);
+    return woken;
+}
+
+static void futex_wake(rthreads_atomic_t* ptr, bool all)
+{
+    InitOnceExecuteOnce(&futex_once, futex_resolve, NULL, NULL);
+    if (wait_on_address)
+    {
+        if (all)
+            wake_by_address_all((PVOID)ptr);
+        else
+            wake_by_address_single((PVOID)ptr);
+        return;
+    }
+
+    /* Taking the park lock orders this against a waiter between its
+     * check and its sleep. */
+    AcquireSRWLockExclusive(&futex_park_lock);
+    WakeAllConditionVariable(&futex_park_cond);
+    ReleaseSRWLockExclusive(&futex_park_lock);
+}
 #else
-    pthread_cond_t cond;
+static rthreads_atomic_t rthreads_cas(rthreads_atomic_t* ptr, rthreads_atomic_t expected, rthreads_atomic_t desired)
+{
+    __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+    return expected;
+}
+#define rthreads_xchg(ptr, value) __atomic_exchange_n((ptr), (value), __ATOMIC_ACQ_REL)
+#define rthreads_add(ptr, value) __atomic_fetch_add((ptr), (value), __ATOMIC_SEQ_CST)
+#define rthreads_load(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#if defined(__i386__) || defined(__x86_64__)
+#define rthreads_pause() __builtin_ia32_pause()
+#else
+#define rthreads_pause() ((void)0)
+#endif
+
+static bool futex_wait(rthreads_atomic_t* ptr, rthreads_atomic_t expected, int64_t timeout_us)
+{
+    struct timespec timeout;
+
+    if (timeout_us >= 0)
+    {
+        timeout.tv_sec = timeout_us / 1000000;
+        timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+    }
+
+    return syscall(SYS_futex, ptr, FUTEX_WAIT_PRIVATE, expected,
+        timeout_us >= 0 ? &timeout : NULL, NULL, 0) == 0 || errno != ETIMEDOUT;
+}
+
+static void futex_wake(rthreads_atomic_t* ptr, bool all)
+{
+    syscall(SYS_futex, ptr, FUTEX_WAKE_PRIVATE, all ? INT32_MAX : 1, NULL, NULL, 0);
+}
+#endif
+
+/* Marks the lock contended and sleeps until it is ours. */
+static void slock_lock_contended(slock_t* lock)
+{
+    unsigned spin;
+
+    for (spin = 0; spin < SLOCK_SPIN_COUNT; spin++)
+    {
+        if (rthreads_load(&lock->state) == 0 && rthreads_cas(&lock->state, 0, 1) == 0)
+        {
+            lock->spun++;
+            return;
+        }
+        rthreads_pause();
+    }
+
+    while (rthreads_xchg(&lock->state, 2) != 0)
+        futex_wait(&lock->state, 2, -1);
+    lock->slept++;
+}
 #endif
-};
 
 #ifdef USE_WIN32_THREADS
 static DWORD CALLBACK thread_wrap(void* data_)
@@ -202,8 +340,30 @@ sthread_t* sthread_create_with_priority(void (*thread_func)(void*), void* userda
 
 #ifdef USE_WIN32_THREADS
     thread->id = 0;
-    thread->thread = CreateThread(NULL, 0, thread_wrap,
-        data, 0, &thread->id);
+    if ((thread_priority >= 1) && (thread_priority <= 100))
+    {
+        /* Map the hint onto the Win32 levels before the thread runs. */
+        int priority = THREAD_PRIORITY_BELOW_NORMAL;
+        if (thread_priority > 90)
+            priority = THREAD_PRIORITY_TIME_CRITICAL;
+        else if (thread_priority > 75)
+            priority = THREAD_PRIORITY_HIGHEST;
+        else if (thread_priority > 50)
+            priority = THREAD_PRIORITY_ABOVE_NORMAL;
+        else if (thread_priority > 25)
+            priority = THREAD_PRIORITY_NORMAL;
+
+        thread->thread = CreateThread(NULL, 0, thread_wrap,
+            data, CREATE_SUSPENDED, &thread->id);
+        if (thread->thread)
+        {
+            SetThreadPriority(thread->thread, priority);
+            ResumeThread(thread->thread);
+        }
+    }
+    else
+        thread->thread = CreateThread(NULL, 0, thread_wrap,
+            data, 0, &thread->id);
     thread_created = !!thread->thread;
 #else
     thread->id = 0;
@@ -329,27 +489,19 @@ bool sthread_isself(sthread_t* thread)
  **/
 slock_t* slock_new(void)
 {
-    bool mutex_created = false;
     slock_t* lock = (slock_t*)calloc(1, sizeof(*lock));
     if (!lock)
         return NULL;
 
-
-#ifdef USE_WIN32_THREADS
-    InitializeCriticalSection(&lock->lock);
-    mutex_created = true;
-#else
-    mutex_created = (pthread_mutex_init(&lock->lock, NULL) == 0);
+#ifndef HAVE_FUTEX_LOCKS
+    if (pthread_mutex_init(&lock->lock, NULL) != 0)
+    {
+        free(lock);
+        return NULL;
+    }
 #endif
 
-    if (!mutex_created)
-        goto error;
-
     return lock;
-
-error:
-    free(lock);
-    return NULL;
 }
 
 /**
@@ -363,9 +515,7 @@ void slock_free(slock_t* lock)
     if (!lock)
         return;
 
-#ifdef USE_WIN32_THREADS
-    DeleteCriticalSection(&lock->lock);
-#else
+#ifndef HAVE_FUTEX_LOCKS
     pthread_mutex_destroy(&lock->lock);
 #endif
     free(lock);
@@ -383,8 +533,9 @@ void slock_lock(slock_t* lock)
 {
     if (!lock)
         return;
-#ifdef USE_WIN32_THREADS
-    EnterCriticalSection(&lock->lock);
+#ifdef HAVE_FUTEX_LOCKS
+    if (rthreads_cas(&lock->state, 0, 1) != 0)
+        slock_lock_contended(lock);
 #else
     pthread_mutex_lock(&lock->lock);
 #endif
@@ -401,8 +552,8 @@ bool slock_try_lock(slock_t* lock)
 {
     if (!lock)
         return false;
-#ifdef USE_WIN32_THREADS
-    return TryEnterCriticalSection(&lock->lock);
+#ifdef HAVE_FUTEX_LOCKS
+    return rthreads_cas(&lock->state, 0, 1) == 0;
 #else
     return pthread_mutex_trylock(&lock->lock) == 0;
 #endif
@@ -418,13 +569,34 @@ void slock_unlock(slock_t* lock)
 {
     if (!lock)
         return;
-#ifdef USE_WIN32_THREADS
-    LeaveCriticalSection(&lock->lock);
+#ifdef HAVE_FUTEX_LOCKS
+    if (rthreads_xchg(&lock->state, 0) == 2)
+        futex_wake(&lock->state, false);
 #else
     pthread_mutex_unlock(&lock->lock);
 #endif
 }
 
+/**
+ * slock_get_contention:
+ * @lock                    : pointer to mutex object
+ * @spun                    : acquisitions which got the mutex while spinning
+ * @slept                   : acquisitions which had to sleep for it
+ *
+ * Reads the contention counters, zero where they aren't tracked.
+ * Only stable while holding the mutex or once no other thread uses it.
+ **/
+void slock_get_contention(slock_t* lock, unsigned* spun, unsigned* slept)
+{
+#ifdef HAVE_FUTEX_LOCKS
+    *spun = lock ? lock->spun : 0;
+    *slept = lock ? lock->slept : 0;
+#else
+    *spun = 0;
+    *slept = 0;
+#endif
+}
+
 /**
  * scond_new:
  *
@@ -441,53 +613,15 @@ scond_t* scond_new(void)
     if (!cond)
         return NULL;
 
-#ifdef USE_WIN32_THREADS
-    /* This is very complex because recreating condition variable semantics
-     * with Win32 parts is not easy.
-     *
-     * The main problem is that a condition variable can't be used to
-     * "pre-wake" a thread (it will get wakened only after it's waited).
-     *
-     * Whereas a win32 event can pre-wake a thread (the event will be set
-     * in advance, so a 'waiter' won't even have to wait on it).
-     *
-     * Keep in mind a condition variable can apparently pre-wake a thread,
-     * insofar as spurious wakeups are always possible,
-     * but nobody will be expecting this and it does not need to be simulated.
-     *
-     * Moreover, we won't be doing this, because it counts as a spurious wakeup
-     * -- someone else with a genuine claim must get wakened, in any case.
-     *
-     * Therefore we choose to wake only one of the correct waiting threads.
-     * So at the very least, we need to do something clever. But there's
-     * bigger problems.
-     * We don't even have a straightforward way in win32 to satisfy
-     * pthread_cond_wait's atomicity requirement. The bulk of this
-     * algorithm is solving that.
-     *
-     * Note: We might could simplify this using vista+ condition variables,
-     * but we wanted an XP compatible solution. */
-    cond->event = CreateEvent(NULL, FALSE, FALSE, NULL);
-    if (!cond->event)
-        goto error;
-    cond->hot_potato = CreateEvent(NULL, FALSE, FALSE, NULL);
-    if (!cond->hot_potato)
+#ifndef HAVE_FUTEX_LOCKS
+    if (pthread_cond_init(&cond->cond, NULL) != 0)
     {
-        CloseHandle(cond->event);
-        goto error;
+        free(cond);
+        return NULL;
     }
-
-    InitializeCriticalSection(&cond->cs);
-#else
-    if (pthread_cond_init(&cond->cond, NULL) != 0)
-        goto error;
 #endif
 
     return cond;
-
-error:
-    free(cond);
-    return NULL;
 }
 
 /**
@@ -501,222 +635,34 @@ void scond_free(scond_t* cond)
     if (!cond)
         return;
 
-#ifdef USE_WIN32_THREADS
-    CloseHandle(cond->event);
-    CloseHandle(cond->hot_potato);
-    DeleteCriticalSection(&cond->cs);
-#else
+#ifndef HAVE_FUTEX_LOCKS
     pthread_cond_destroy(&cond->cond);
 #endif
     free(cond);
 }
 
-#ifdef USE_WIN32_THREADS
-static bool _scond_wait_win32(scond_t* cond, slock_t* lock, DWORD dwMilliseconds)
+#ifdef HAVE_FUTEX_LOCKS
+/* timeout_us < 0 waits forever. */
+static bool scond_wait_futex(scond_t* cond, slock_t* lock, int64_t timeout_us)
 {
-    struct queue_entry myentry;
-    struct queue_entry** ptr;
-
-#if _WIN32_WINNT >= 0x0500 || defined(_XBOX)
-    static LARGE_INTEGER performanceCounterFrequency;
-    LARGE_INTEGER tsBegin;
-    static bool first_init = true;
-#else
-    static bool beginPeriod = false;
-    DWORD tsBegin;
-#endif
-
-    DWORD waitResult;
-    DWORD dwFinalTimeout = dwMilliseconds; /* Careful! in case we begin in the head,
-                                              we don't do the hot potato stuff,
-                                              so this timeout needs presetting. */
-
-                                              /* Reminder: `lock` is held before this is called. */
-                                              /* however, someone else may have called scond_signal without the lock. soo... */
-    EnterCriticalSection(&cond->cs);
-
-    /* since this library is meant for realtime game software
-     * I have no problem setting this to 1 and forgetting about it. */
-#if _WIN32_WINNT >= 0x0500 || defined(_XBOX)
-    if (first_init)
-    {
-        performanceCounterFrequency.QuadPart = 0;
-        first_init = false;
-    }
-
-    if (performanceCounterFrequency.QuadPart == 0)
-    {
-        QueryPerformanceFrequency(&performanceCounterFrequency);
-    }
-#else
-    if (!beginPeriod)
-    {
-        beginPeriod = true;
-        timeBeginPeriod(1);
-    }
-#endif
-
-    /* Now we can take a good timestamp for use in faking the timeout ourselves. */
-    /* But don't bother unless we need to (to save a little time) */
-    if (dwMilliseconds != INFINITE)
-#if _WIN32_WINNT >= 0x0500 || defined(_XBOX)
-        QueryPerformanceCounter(&tsBegin);
-#else
-        tsBegin = timeGetTime();
-#endif
-
-    /* add ourselves to a queue of waiting threads */
-    ptr = &cond->head;
-
-    /* walk to the end of the linked list */
-    while (*ptr)
-        ptr = &((*ptr)->next);
-
-    *ptr = &myentry;
-    myentry.next = NULL;
-
-    cond->waiters++;
-
-    /* now the conceptual lock release and condition block are supposed to be atomic.
-     * we can't do that in Windows, but we can simulate the effects by using
-     * the queue, by the following analysis:
-     * What happens if they aren't atomic?
-     *
-     * 1. a signaller can rush in and signal, expecting a waiter to get it;
-     * but the waiter wouldn't, because he isn't blocked yet.
-     * Solution: Win32 events make this easy. The event will sit there enabled
-     *
-     * 2. a signaller can rush in and signal, and then turn right around and wait.
-     * Solution: the signaller will get queued behind the waiter, who's
-     * enqueued before he releases the mutex. */
-
-     /* It's my turn if I'm the head of the queue.
-      * Check to see if it's my turn. */
-    while (cond->head != &myentry)
-    {
-        /* It isn't my turn: */
-        DWORD timeout = INFINITE;
+    bool woken;
+    rthreads_atomic_t seq;
 
-        /* As long as someone is even going to be able to wake up
-         * when they receive the potato, keep it going round. */
-        if (cond->wakens > 0)
-            SetEvent(cond->hot_potato);
+    /* Register before sampling seq: a signal which doesn't see us must
+     * have bumped seq before we read it, so it wasn't meant for us. */
+    rthreads_add(&cond->waiters, 1);
+    seq = rthreads_load(&cond->seq);
 
-        /* Assess the remaining timeout time */
-        if (dwMilliseconds != INFINITE)
-        {
-#if _WIN32_WINNT >= 0x0500 || defined(_XBOX)
-            LARGE_INTEGER now;
-            LONGLONG elapsed;
-
-            QueryPerformanceCounter(&now);
-            elapsed = now.QuadPart - tsBegin.QuadPart;
-            elapsed *= 1000;
-            elapsed /= performanceCounterFrequency.QuadPart;
-#else
-            DWORD now = timeGetTime();
-            DWORD elapsed = now - tsBegin;
-#endif
-
-            /* Try one last time with a zero timeout (keeps the code simpler) */
-            if (elapsed > dwMilliseconds)
-                elapsed = dwMilliseconds;
-
-            timeout = dwMilliseconds - elapsed;
-        }
+    slock_unlock(lock);
+    woken = futex_wait(&cond->seq, seq, timeout_us);
+    rthreads_add(&cond->waiters, -1);
 
-        /* Let someone else go */
-        LeaveCriticalSection(&lock->lock);
-        LeaveCriticalSection(&cond->cs);
+    /* Other waiters may be parked on the mutex as well, so take it as
+     * contended and let our unlock wake the next one. */
+    while (rthreads_xchg(&lock->state, 2) != 0)
+        futex_wait(&lock->state, 2, -1);
 
-        /* Wait a while to catch the hot potato..
-         * someone else should get a chance to go */
-         /* After all, it isn't my turn (and it must be someone else's) */
-        Sleep(0);
-        waitResult = WaitForSingleObject(cond->hot_potato, timeout);
-
-        /* I should come out of here with the main lock taken */
-        EnterCriticalSection(&lock->lock);
-        EnterCriticalSection(&cond->cs);
-
-        if (waitResult == WAIT_TIMEOUT)
-        {
-            /* Out of time! Now, let's think about this. I do have the potato now--
-             * maybe it's my turn, and I have the event?
-             * If that's the case, I could proceed right now without aborting
-             * due to timeout.
-             *
-             * However.. I DID wait a real long time. The caller was willing
-             * to wait that long.
-             *
-             * I choose to give him one last chance with a zero timeout
-             * in the next step
-             */
-            if (cond->head == &myentry)
-            {
-                dwFinalTimeout = 0;
-                break;
-            }
-            else
-            {
-                /* It's not our turn and we're out of time. Give up.
-                 * Remove ourself from the queue and bail. */
-                struct queue_entry* curr = cond->head;
-
-                while (curr->next != &myentry)
-                    curr = curr->next;
-                curr->next = myentry.next;
-                cond->waiters--;
-                LeaveCriticalSection(&cond->cs);
-                return false;
-            }
-        }
-
-    }
-
-    /* It's my turn now -- and I hold the potato */
-
-    /* I still have the main lock, in any case */
-    /* I need to release it so that someone can set the event */
-    LeaveCriticalSection(&lock->lock);
-    LeaveCriticalSection(&cond->cs);
-
-    /* Wait for someone to actually signal this condition */
-    /* We're the only waiter waiting on the event right now -- everyone else
-     * is waiting on something different */
-    waitResult = WaitForSingleObject(cond->event, dwFinalTimeout);
-
-    /* Take the main lock so we can do work. Nobody else waits on this lock
-     * for very long, so even though it's GO TIME we won't have to wait long */
-    EnterCriticalSection(&lock->lock);
-    EnterCriticalSection(&cond->cs);
-
-    /* Remove ourselves from the queue */
-    cond->head = myentry.next;
-    cond->waiters--;
-
-    if (waitResult == WAIT_TIMEOUT)
-    {
-        /* Oops! ran out of time in the final wait. Just bail. */
-        LeaveCriticalSection(&cond->cs);
-        return false;
-    }
-
-    /* If any other wakenings are pending, go ahead and set it up  */
-    /* There may actually be no waiters. That's OK. The first waiter will come in,
-     * find it's his turn, and immediately get the signaled event */
-    cond->wakens--;
-    if (cond->wakens > 0)
-    {
-        SetEvent(cond->event);
-
-        /* Progress the queue: Put the hot potato back into play. It'll be
-         * tossed around until next in line gets it */
-        SetEvent(cond->hot_potato);
-    }
-
-    LeaveCriticalSection(&cond->cs);
-    return true;
+    return woken;
 }
 #endif
 
@@ -729,8 +675,8 @@ static bool _scond_wait_win32(scond_t* cond, slock_t* lock, DWORD dwMilliseconds
  **/
 void scond_wait(scond_t* cond, slock_t* lock)
 {
-#ifdef USE_WIN32_THREADS
-    _scond_wait_win32(cond, lock, INFINITE);
+#ifdef HAVE_FUTEX_LOCKS
+    scond_wait_futex(cond, lock, -1);
 #else
     pthread_cond_wait(&cond->cond, &lock->lock);
 #endif
@@ -745,19 +691,10 @@ void scond_wait(scond_t* cond, slock_t* lock)
  **/
 int scond_broadcast(scond_t* cond)
 {
-#ifdef USE_WIN32_THREADS
-    /* remember: we currently have mutex */
-    if (cond->waiters == 0)
-        return 0;
-
-    /* awaken everything which is currently queued up */
-    if (cond->wakens == 0)
-        SetEvent(cond->event);
-    cond->wakens = cond->waiters;
-
-    /* Since there is now at least one pending waken, the potato must be in play */
-    SetEvent(cond->hot_potato);
-
+#ifdef HAVE_FUTEX_LOCKS
+    rthreads_add(&cond->seq, 1);
+    if (rthreads_load(&cond->waiters))
+        futex_wake(&cond->seq, true);
     return 0;
 #else
     return pthread_cond_broadcast(&cond->cond);
@@ -773,38 +710,10 @@ int scond_broadcast(scond_t* cond)
  **/
 void scond_signal(scond_t* cond)
 {
-#ifdef USE_WIN32_THREADS
-
-    /* Unfortunately, pthread_cond_signal does not require that the
-     * lock be held in advance */
-     /* To avoid stomping on the condvar from other threads, we need
-      * to control access to it with this */
-    EnterCriticalSection(&cond->cs);
-
-    /* remember: we currently have mutex */
-    if (cond->waiters == 0)
-    {
-        LeaveCriticalSection(&cond->cs);
-        return;
-    }
-
-    /* wake up the next thing in the queue */
-    if (cond->wakens == 0)
-        SetEvent(cond->event);
-
-    cond->wakens++;
-
-    /* The data structure is done being modified.. I think we can leave the CS now.
-     * This would prevent some other thread from receiving the hot potato and then
-     * immediately stalling for the critical section.
-     * But remember, we were trying to replicate a semantic where this entire
-     * scond_signal call was controlled (by the user) by a lock.
-     * So in case there's trouble with this, we can move it after SetEvent() */
-    LeaveCriticalSection(&cond->cs);
-
-    /* Since there is now at least one pending waken, the potato must be in play */
-    SetEvent(cond->hot_potato);
-
+#ifdef HAVE_FUTEX_LOCKS
+    rthreads_add(&cond->seq, 1);
+    if (rthreads_load(&cond->waiters))
+        futex_wake(&cond->seq, false);
 #else
     pthread_cond_signal(&cond->cond);
 #endif
@@ -824,30 +733,12 @@ void scond_signal(scond_t* cond)
  **/
 bool scond_wait_timeout(scond_t* cond, slock_t* lock, int64_t timeout_us)
 {
-#ifdef USE_WIN32_THREADS
-    /* How to convert a microsecond (us) timeout to millisecond (ms)?
-     *
-     * Someone asking for a 0 timeout clearly wants immediate timeout.
-     * Someone asking for a 1 timeout clearly wants an actual timeout
-     * of the minimum length */
-
-     /* Someone asking for 1000 or 1001 timeout shouldn't
-      * accidentally get 2ms. */
-    DWORD dwMilliseconds = timeout_us / 1000;
-
-    /* The implementation of a 0 timeout here with pthreads is sketchy.
-     * It isn't clear what happens if pthread_cond_timedwait is called with NOW.
-     * Moreover, it is possible that this thread gets pre-empted after the
-     * clock_gettime but before the pthread_cond_timedwait.
-     * In order to help smoke out problems caused by this strange usage,
-     * let's treat a 0 timeout as always timing out.
-     */
-    if (timeout_us == 0)
+#ifdef HAVE_FUTEX_LOCKS
+    /* Treat a 0 timeout as always timing out, like the pthread path
+     * can't reliably do anything else with it. */
+    if (timeout_us <= 0)
         return false;
-    else if (timeout_us < 1000)
-        dwMilliseconds = 1;
-
-    return _scond_wait_win32(cond, lock, dwMilliseconds);
+    return scond_wait_futex(cond, lock, timeout_us);
 #else
     int ret;
     int64_t seconds, remainder;
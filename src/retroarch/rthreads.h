@@ -137,6 +137,17 @@ bool slock_try_lock(slock_t* lock);
  **/
 void slock_unlock(slock_t* lock);
 
+/**
+ * slock_get_contention:
+ * @lock                    : pointer to mutex object
+ * @spun                    : acquisitions which got the mutex while spinning
+ * @slept                   : acquisitions which had to sleep for it
+ *
+ * Reads the contention counters, zero where they aren't tracked.
+ * Only stable while holding the mutex or once no other thread uses it.
+ **/
+void slock_get_contention(slock_t* lock, unsigned* spun, unsigned* slept);
+
 /**
  * scond_new:
  *
@@ -19,12 +19,19 @@
 #include "vulkan_common.h"
 #include "slang_reflection.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <functional>
 #include <memory>
 #include <vector>
 #include <string>
 #include <unordered_map>
 
+/* Upper bound on threads used to build passes in parallel. */
+#define VULKAN_FILTER_CHAIN_MAX_BUILD_WORKERS 4
+
 struct Texture
 {
     vulkan_filter_chain_texture texture;
@@ -326,6 +333,19 @@ private:
     std::vector<Parameter> parameters;
     std::vector<Parameter> filtered_parameters;
 
+    /* Parameters the shader declares as specialization constants are
+     * baked into the pipeline with their preset values when the pass
+     * is built. Later changes only take effect on the next rebuild, so
+     * parameters meant to be tweaked live belong on the UBO or push
+     * constant path. */
+    struct SpecParameter
+    {
+        unsigned index;
+        uint32_t constant_id;
+    };
+
+    std::vector<SpecParameter> spec_parameters;
+
     struct PushConstant
     {
         VkShaderStageFlags stages = 0;
@@ -378,6 +398,8 @@ public:
 
     VkFormat get_pass_rt_format(unsigned pass);
 
+    void retire(vulkan_filter_chain* old);
+
 private:
     VkDevice device;
     VkPhysicalDevice gpu;
@@ -394,6 +416,9 @@ private:
     Size2D max_input_size;
     vulkan_filter_chain_swapchain_info swapchain_info;
     unsigned current_sync_index;
+    /* Set once the chain has been replaced, its last frame is known
+     * to have retired by the time it gets deleted. */
+    bool retired = false;
 
     void flush();
 
@@ -402,6 +427,7 @@ private:
     void set_num_sync_indices(unsigned num_indices);
     void set_swapchain_info(const vulkan_filter_chain_swapchain_info& info);
 
+    bool build_passes();
     bool init_ubo();
     bool init_history();
     bool init_feedback();
@@ -595,6 +621,19 @@ void Framebuffer::set_size(DeferredDisposer& disposer, const Size2D& size, VkFor
     init(&disposer);
 }
 
+/* Full chain down to 1x1. */
+static unsigned glslang_num_miplevels(unsigned width, unsigned height)
+{
+    unsigned size = std::max(width, height);
+    unsigned levels = 0;
+    while (size)
+    {
+        levels++;
+        size >>= 1;
+    }
+    return levels;
+}
+
 void Framebuffer::init(DeferredDisposer* disposer)
 {
     VkMemoryRequirements mem_reqs;
@@ -608,7 +647,7 @@ void Framebuffer::init(DeferredDisposer* disposer)
     info.extent.width = size.width;
     info.extent.height = size.height;
     info.extent.depth = 1;
-    info.mipLevels = 0; // std::min(max_levels, glslang_num_miplevels(size.width, size.height));
+    info.mipLevels = std::min(max_levels, glslang_num_miplevels(size.width, size.height));
     info.arrayLayers = 1;
     info.samples = VK_SAMPLE_COUNT_1_BIT;
     info.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -891,6 +930,7 @@ bool Pass::init_pipeline_layout()
 
 bool Pass::init_pipeline()
 {
+    unsigned i;
     VkPipelineInputAssemblyStateCreateInfo input_assembly = {
        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
     VkVertexInputAttributeDescription attributes[2] = { {0} };
@@ -920,6 +960,9 @@ bool Pass::init_pipeline()
        VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
     VkGraphicsPipelineCreateInfo pipe = {
        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+    VkSpecializationInfo specialization = { 0 };
+    std::vector<VkSpecializationMapEntry> spec_entries(spec_parameters.size());
+    std::vector<float> spec_values(spec_parameters.size());
 
     if (!init_pipeline_layout())
         return false;
@@ -981,17 +1024,37 @@ bool Pass::init_pipeline()
     dynamic.pDynamicStates = dynamics;
     dynamic.dynamicStateCount = sizeof(dynamics) / sizeof(dynamics[0]);
 
+    /* Specialization constants */
+    for (i = 0; i < spec_parameters.size(); i++)
+    {
+        spec_entries[i].constantID = spec_parameters[i].constant_id;
+        spec_entries[i].offset = i * sizeof(float);
+        spec_entries[i].size = sizeof(float);
+        spec_values[i] = common->shader_preset
+            ? common->shader_preset->parameters[spec_parameters[i].index].current
+            : 0.0f;
+    }
+
+    specialization.mapEntryCount = (uint32_t)spec_entries.size();
+    specialization.pMapEntries = spec_entries.data();
+    specialization.dataSize = spec_values.size() * sizeof(float);
+    specialization.pData = spec_values.data();
+
     /* Shaders */
     module_info.codeSize = vertex_shader.size() * sizeof(uint32_t);
     module_info.pCode = vertex_shader.data();
     shader_stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
     shader_stages[0].pName = "main";
+    if (!spec_parameters.empty())
+        shader_stages[0].pSpecializationInfo = &specialization;
     vkCreateShaderModule(device, &module_info, NULL, &shader_stages[0].module);
 
     module_info.codeSize = fragment_shader.size() * sizeof(uint32_t);
     module_info.pCode = fragment_shader.data();
     shader_stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     shader_stages[1].pName = "main";
+    if (!spec_parameters.empty())
+        shader_stages[1].pSpecializationInfo = &specialization;
     vkCreateShaderModule(device, &module_info, NULL, &shader_stages[1].module);
 
     pipe.stageCount = 2;
@@ -1051,17 +1114,22 @@ bool Pass::build()
     reflection.texture_semantic_uniform_map = &common->texture_semantic_uniform_map;
     reflection.semantic_map = &semantic_map;
 
-    if (!slang_reflect_spirv(vertex_shader, fragment_shader, &reflection))
+    if (!slang_reflect_spirv_cached(vertex_shader, fragment_shader, &reflection))
         return false;
 
     /* Filter out parameters which we will never use anyways. */
     filtered_parameters.clear();
 
+    spec_parameters.clear();
+
     for (i = 0; i < reflection.semantic_float_parameters.size(); i++)
     {
         if (reflection.semantic_float_parameters[i].uniform ||
             reflection.semantic_float_parameters[i].push_constant)
             filtered_parameters.push_back(parameters[i]);
+        if (reflection.semantic_float_parameters[i].specialization)
+            spec_parameters.push_back({ parameters[i].index,
+                reflection.semantic_float_parameters[i].constant_id });
     }
 
     return init_pipeline();
@@ -1758,14 +1826,59 @@ bool vulkan_filter_chain::init_history()
     return true;
 }
 
+/* Pass::build only reads shared state (semantic maps, pipeline cache),
+ * so reflection and pipeline compilation can run on a handful of
+ * workers. The calling thread takes part, and failures are reported
+ * for the lowest failing pass so the result does not depend on
+ * scheduling. */
+bool vulkan_filter_chain::build_passes()
+{
+    unsigned i;
+    unsigned num_workers;
+    std::atomic<unsigned> next{ 0 };
+    std::vector<std::thread> workers;
+    std::unique_ptr<bool[]> built{ new bool[passes.size()] };
+
+    auto worker = [&]() {
+        unsigned index;
+        while ((index = next.fetch_add(1)) < passes.size())
+            built[index] = passes[index]->build();
+    };
+
+    num_workers = std::min<unsigned>(std::thread::hardware_concurrency(),
+        VULKAN_FILTER_CHAIN_MAX_BUILD_WORKERS);
+    num_workers = std::min<unsigned>(num_workers, (unsigned)passes.size());
+
+    for (i = 1; i < num_workers; i++)
+        workers.emplace_back(worker);
+    worker();
+    for (auto& thread : workers)
+        thread.join();
+
+    for (i = 0; i < passes.size(); i++)
+    {
+        if (!built[i])
+        {
+            RARCH_LOG("[Vulkan filter chain]: Failed to build pass #%u.\n", i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
 bool vulkan_filter_chain::init()
 {
     unsigned i;
     Size2D source = max_input_size;
+    slang_reflection_cache_stats before = slang_reflection_cache_get_stats();
+    slang_reflection_cache_stats after;
+    auto start = std::chrono::steady_clock::now();
 
     if (!init_alias())
         return false;
 
+    /* Sizes chain from pass to pass, so that part stays serial. */
     for (i = 0; i < passes.size(); i++)
     {
 #ifdef VULKAN_DEBUG
@@ -1777,10 +1890,26 @@ bool vulkan_filter_chain::init()
 #endif
         source = passes[i]->set_pass_info(max_input_size,
             source, swapchain_info, pass_info[i]);
-        if (!passes[i]->build())
-            return false;
     }
 
+    if (!build_passes())
+        return false;
+
+    after = slang_reflection_cache_get_stats();
+    RARCH_LOG("[Vulkan filter chain]: Built %u pass(es) in %.3f ms, reflection %u hit(s) %.3f ms, %u miss(es) %.3f ms.\n",
+        (unsigned)passes.size(),
+        std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count(),
+        after.hits - before.hits,
+        (after.hit_usec - before.hit_usec) / 1000.0,
+        after.misses - before.misses,
+        (after.miss_usec - before.miss_usec) / 1000.0);
+    if (after.arena_allocations != before.arena_allocations)
+        RARCH_LOG("[Vulkan filter chain]: SPIRV-Cross arena served %u allocation(s), %u KiB in %u block(s).\n",
+            (unsigned)(after.arena_allocations - before.arena_allocations),
+            (unsigned)((after.arena_bytes - before.arena_bytes) / 1024),
+            (unsigned)(after.arena_blocks - before.arena_blocks));
+
     require_clear = false;
     if (!init_ubo())
         return false;
@@ -2123,7 +2252,20 @@ vulkan_filter_chain::vulkan_filter_chain(
 
 vulkan_filter_chain::~vulkan_filter_chain()
 {
-    flush();
+    if (retired)
+        execute_deferred();
+    else
+        flush();
+}
+
+void vulkan_filter_chain::retire(vulkan_filter_chain* old)
+{
+    /* The old chain was last used by the previous frame. Deleting it
+     * once this sync index comes around again means its fence has
+     * been waited, so there is no need to idle the device. */
+    old->retired = true;
+    DeferredDisposer disposer(deferred_calls[current_sync_index]);
+    disposer.defer([old] { delete old; });
 }
 
 void vulkan_filter_chain::set_num_passes(unsigned num_passes)
@@ -2194,6 +2336,13 @@ void vulkan_filter_chain_free(
     delete chain;
 }
 
+void vulkan_filter_chain_retire(
+    vulkan_filter_chain_t* chain,
+    vulkan_filter_chain_t* old)
+{
+    chain->retire(old);
+}
+
 bool vulkan_filter_chain_update_swapchain_info(
     vulkan_filter_chain_t* chain,
     const vulkan_filter_chain_swapchain_info* info)
@@ -110,6 +110,11 @@ extern "C" {
         const struct vulkan_filter_chain_create_info* info,
         enum glslang_filter_chain_filter filter);
     void vulkan_filter_chain_free(vulkan_filter_chain_t* chain);
+    /* Hands the replaced chain to the new one, which deletes it once
+     * the current sync index has been waited on again. Call after
+     * vulkan_filter_chain_notify_sync_index. */
+    void vulkan_filter_chain_retire(vulkan_filter_chain_t* chain,
+        vulkan_filter_chain_t* old);
     bool vulkan_filter_chain_update_swapchain_info(vulkan_filter_chain_t* chain,
         const struct vulkan_filter_chain_swapchain_info* info);
     void vulkan_filter_chain_notify_sync_index(vulkan_filter_chain_t* chain,
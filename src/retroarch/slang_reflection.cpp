@@ -17,7 +17,11 @@
 #include "retroarch.h"
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <stdio.h>
+#include <string.h>
 #include "compat_strl.h"
 #include "../spirv-cross/spirv_cross.hpp"
 
@@ -392,6 +396,50 @@ static bool add_active_buffer_ranges(
 }
 
 
+/* Parameters declared as specialization constants are baked into the
+ * pipeline instead of being read from the UBO or push constants. Other
+ * specialization constants keep the default from the shader. */
+static bool add_specialization_constants(const Compiler& compiler,
+    slang_reflection* reflection)
+{
+    for (auto& constant : compiler.get_specialization_constants())
+    {
+        const std::string& name = compiler.get_name(constant.id);
+        auto itr = reflection->semantic_map->find(name);
+
+        if (itr == end(*reflection->semantic_map) ||
+            itr->second.semantic != SLANG_SEMANTIC_FLOAT_PARAMETER)
+            continue;
+
+        const SPIRType& type = compiler.get_type(
+            compiler.get_constant(constant.id).constant_type);
+        if (type.basetype != SPIRType::Float || type.vecsize != 1 || type.columns != 1)
+        {
+            RARCH_LOG("[slang]: Specialization constant '%s' is not a float, keeping its default.\n",
+                name.c_str());
+            continue;
+        }
+
+        resize_minimum(reflection->semantic_float_parameters,
+            itr->second.index + 1);
+        slang_semantic_meta& meta =
+            reflection->semantic_float_parameters[itr->second.index];
+
+        if (meta.specialization && meta.constant_id != constant.constant_id)
+        {
+            RARCH_ERR("[slang]: Specialization constant '%s' uses different ids"
+                " in vertex and fragment.\n", name.c_str());
+            return false;
+        }
+
+        meta.specialization = true;
+        meta.constant_id = constant.constant_id;
+        meta.num_components = 1;
+    }
+
+    return true;
+}
+
 slang_reflection::slang_reflection()
 {
     unsigned i;
@@ -663,6 +711,10 @@ bool slang_reflect(
         semantic.texture = true;
     }
 
+    if (!add_specialization_constants(vertex_compiler, reflection) ||
+        !add_specialization_constants(fragment_compiler, reflection))
+        return false;
+
 #ifdef DEBUG
     RARCH_LOG("[slang]: Reflection\n");
     RARCH_LOG("[slang]:   Textures:\n");
@@ -750,18 +802,41 @@ bool slang_reflect(
         if (param->push_constant)
             RARCH_LOG("[slang]:     #%u (PushOffset: %u)\n", i,
                 (unsigned int)param->push_constant_offset);
+        if (param->specialization)
+            RARCH_LOG("[slang]:     #%u (SpecId: %u)\n", i,
+                (unsigned int)param->constant_id);
     }
 #endif
 
     return true;
 }
 
+static std::atomic<uint64_t> arena_allocations;
+static std::atomic<uint64_t> arena_bytes;
+static std::atomic<uint64_t> arena_blocks;
+
 bool slang_reflect_spirv(const std::vector<uint32_t>& vertex,
     const std::vector<uint32_t>& fragment,
     slang_reflection* reflection)
 {
+    /* All IR lives only for this call, so let SPIRV-Cross bump allocate
+     * it and drop everything at once instead of freeing node by node. */
+    spirv_cross::Arena arena;
+    struct arena_stats_guard
+    {
+        const spirv_cross::Arena& arena;
+        ~arena_stats_guard()
+        {
+            const spirv_cross::Arena::Stats& stats = arena.get_stats();
+            arena_allocations += stats.allocations;
+            arena_bytes += stats.bytes;
+            arena_blocks += stats.blocks;
+        }
+    } stats_guard{ arena };
+
     try
     {
+        spirv_cross::ArenaScope scope(arena);
         Compiler vertex_compiler(vertex);
         Compiler fragment_compiler(fragment);
         spirv_cross::ShaderResources
@@ -786,3 +861,402 @@ bool slang_reflect_spirv(const std::vector<uint32_t>& vertex,
         return false;
     }
 }
+
+/* Reflection cache.
+ *
+ * File layout, all little endian:
+ *   u32 magic, u32 version,
+ *   then { u64 key, u32 size, u8 data[size] } until EOF.
+ * Entries are appended on every miss; a later entry with the same
+ * key wins. Bump SLANG_REFLECTION_CACHE_VERSION whenever the
+ * serialized layout or the reflection rules change. */
+
+#define SLANG_REFLECTION_CACHE_MAGIC   0x43524c53u /* "SLRC" */
+#define SLANG_REFLECTION_CACHE_VERSION 2u
+
+namespace
+{
+struct reflection_writer
+{
+    std::vector<uint8_t> data;
+
+    void u32(uint32_t v)
+    {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+        data.insert(data.end(), p, p + sizeof(v));
+    }
+
+    void u64(uint64_t v)
+    {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+        data.insert(data.end(), p, p + sizeof(v));
+    }
+};
+
+struct reflection_reader
+{
+    const uint8_t* data;
+    size_t size;
+    size_t offset;
+    bool ok;
+
+    uint32_t u32()
+    {
+        uint32_t v = 0;
+        if (offset + sizeof(v) > size)
+        {
+            ok = false;
+            return 0;
+        }
+        memcpy(&v, data + offset, sizeof(v));
+        offset += sizeof(v);
+        return v;
+    }
+
+    uint64_t u64()
+    {
+        uint64_t v = 0;
+        if (offset + sizeof(v) > size)
+        {
+            ok = false;
+            return 0;
+        }
+        memcpy(&v, data + offset, sizeof(v));
+        offset += sizeof(v);
+        return v;
+    }
+};
+
+struct reflection_cache
+{
+    std::mutex lock;
+    std::unordered_map<uint64_t, std::vector<uint8_t>> entries;
+    std::string path;
+    slang_reflection_cache_stats stats;
+    bool loaded = false;
+};
+
+static reflection_cache& get_reflection_cache()
+{
+    static reflection_cache cache;
+    return cache;
+}
+}
+
+static void write_texture_meta(reflection_writer& w,
+    const slang_texture_semantic_meta& meta)
+{
+    w.u64(meta.ubo_offset);
+    w.u64(meta.push_constant_offset);
+    w.u32(meta.binding);
+    w.u32(meta.stage_mask);
+    w.u32(meta.texture | (meta.uniform << 1) | (meta.push_constant << 2));
+}
+
+static void read_texture_meta(reflection_reader& r,
+    slang_texture_semantic_meta& meta)
+{
+    uint32_t flags;
+    meta.ubo_offset = (size_t)r.u64();
+    meta.push_constant_offset = (size_t)r.u64();
+    meta.binding = r.u32();
+    meta.stage_mask = r.u32();
+    flags = r.u32();
+    meta.texture = (flags & 1) != 0;
+    meta.uniform = (flags & 2) != 0;
+    meta.push_constant = (flags & 4) != 0;
+}
+
+static void write_meta(reflection_writer& w, const slang_semantic_meta& meta)
+{
+    w.u64(meta.ubo_offset);
+    w.u64(meta.push_constant_offset);
+    w.u32(meta.num_components);
+    w.u32(meta.constant_id);
+    w.u32(meta.uniform | (meta.push_constant << 1) | (meta.specialization << 2));
+}
+
+static void read_meta(reflection_reader& r, slang_semantic_meta& meta)
+{
+    uint32_t flags;
+    meta.ubo_offset = (size_t)r.u64();
+    meta.push_constant_offset = (size_t)r.u64();
+    meta.num_components = r.u32();
+    meta.constant_id = r.u32();
+    flags = r.u32();
+    meta.uniform = (flags & 1) != 0;
+    meta.push_constant = (flags & 2) != 0;
+    meta.specialization = (flags & 4) != 0;
+}
+
+void slang_reflection_serialize(const slang_reflection& reflection,
+    std::vector<uint8_t>& data)
+{
+    unsigned i;
+    reflection_writer w;
+
+    w.u64(reflection.ubo_size);
+    w.u64(reflection.push_constant_size);
+    w.u32(reflection.ubo_binding);
+    w.u32(reflection.ubo_stage_mask);
+    w.u32(reflection.push_constant_stage_mask);
+
+    for (i = 0; i < SLANG_NUM_TEXTURE_SEMANTICS; i++)
+    {
+        w.u32((uint32_t)reflection.semantic_textures[i].size());
+        for (auto& meta : reflection.semantic_textures[i])
+            write_texture_meta(w, meta);
+    }
+
+    for (i = 0; i < SLANG_NUM_SEMANTICS; i++)
+        write_meta(w, reflection.semantics[i]);
+
+    w.u32((uint32_t)reflection.semantic_float_parameters.size());
+    for (auto& meta : reflection.semantic_float_parameters)
+        write_meta(w, meta);
+
+    data = std::move(w.data);
+}
+
+bool slang_reflection_deserialize(const uint8_t* data, size_t size,
+    slang_reflection* reflection)
+{
+    unsigned i;
+    uint32_t count;
+    reflection_reader r = { data, size, 0, true };
+
+    reflection->ubo_size = (size_t)r.u64();
+    reflection->push_constant_size = (size_t)r.u64();
+    reflection->ubo_binding = r.u32();
+    reflection->ubo_stage_mask = r.u32();
+    reflection->push_constant_stage_mask = r.u32();
+
+    for (i = 0; i < SLANG_NUM_TEXTURE_SEMANTICS; i++)
+    {
+        count = r.u32();
+        /* Every element takes more than one byte, so a count larger
+         * than what's left can only be corruption. */
+        if (!r.ok || count > size - r.offset)
+            return false;
+        reflection->semantic_textures[i].resize(count);
+        for (auto& meta : reflection->semantic_textures[i])
+            read_texture_meta(r, meta);
+    }
+
+    for (i = 0; i < SLANG_NUM_SEMANTICS; i++)
+        read_meta(r, reflection->semantics[i]);
+
+    count = r.u32();
+    if (!r.ok || count > size - r.offset)
+        return false;
+    reflection->semantic_float_parameters.resize(count);
+    for (auto& meta : reflection->semantic_float_parameters)
+        read_meta(r, meta);
+
+    return r.ok && r.offset == size;
+}
+
+static uint64_t hash_bytes(uint64_t h, const void* data, size_t size)
+{
+    size_t i;
+    const uint8_t* p = (const uint8_t*)data;
+    for (i = 0; i < size; i++)
+        h = (h ^ p[i]) * 0x100000001b3ull;
+    return h;
+}
+
+/* Map iteration order is unspecified, so entries are hashed on their
+ * own and summed. */
+template <typename P>
+static uint64_t hash_semantic_map(
+    const std::unordered_map<std::string, P>* map)
+{
+    uint64_t h = 0;
+    if (!map)
+        return 0;
+    for (auto& entry : *map)
+    {
+        uint64_t e = hash_bytes(0xcbf29ce484222325ull,
+            entry.first.data(), entry.first.size());
+        e = hash_bytes(e, &entry.second.semantic, sizeof(entry.second.semantic));
+        e = hash_bytes(e, &entry.second.index, sizeof(entry.second.index));
+        h += e;
+    }
+    return h;
+}
+
+static uint64_t slang_reflection_key(const std::vector<uint32_t>& vertex,
+    const std::vector<uint32_t>& fragment,
+    const slang_reflection* reflection)
+{
+    uint64_t sizes[2] = { vertex.size(), fragment.size() };
+    uint64_t maps[3] = {
+        hash_semantic_map(reflection->texture_semantic_map),
+        hash_semantic_map(reflection->texture_semantic_uniform_map),
+        hash_semantic_map(reflection->semantic_map),
+    };
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    h = hash_bytes(h, sizes, sizeof(sizes));
+    h = hash_bytes(h, vertex.data(), vertex.size() * sizeof(uint32_t));
+    h = hash_bytes(h, fragment.data(), fragment.size() * sizeof(uint32_t));
+    h = hash_bytes(h, maps, sizeof(maps));
+    h = hash_bytes(h, &reflection->pass_number, sizeof(reflection->pass_number));
+    return h;
+}
+
+static void slang_reflection_cache_load(reflection_cache& cache)
+{
+    FILE* file;
+    uint32_t header[2];
+
+    cache.loaded = true;
+    if (cache.path.empty() || !(file = fopen(cache.path.c_str(), "rb")))
+        return;
+
+    if (fread(header, sizeof(header), 1, file) != 1
+        || header[0] != SLANG_REFLECTION_CACHE_MAGIC
+        || header[1] != SLANG_REFLECTION_CACHE_VERSION)
+    {
+        RARCH_LOG("[slang]: Ignoring stale reflection cache \"%s\".\n",
+            cache.path.c_str());
+        fclose(file);
+        remove(cache.path.c_str());
+        return;
+    }
+
+    for (;;)
+    {
+        uint64_t key;
+        uint32_t size;
+        std::vector<uint8_t> data;
+
+        if (fread(&key, sizeof(key), 1, file) != 1
+            || fread(&size, sizeof(size), 1, file) != 1)
+            break;
+
+        /* Nothing we write comes close; treat as a torn tail. */
+        if (size > 64 * 1024)
+            break;
+
+        data.resize(size);
+        if (size && fread(data.data(), size, 1, file) != 1)
+            break;
+        cache.entries[key] = std::move(data);
+    }
+
+    fclose(file);
+    RARCH_LOG("[slang]: Loaded %u cached reflection(s).\n",
+        (unsigned)cache.entries.size());
+}
+
+static void slang_reflection_cache_append(reflection_cache& cache,
+    uint64_t key, const std::vector<uint8_t>& data)
+{
+    FILE* file;
+    long pos;
+    uint32_t size = (uint32_t)data.size();
+
+    if (cache.path.empty() || !(file = fopen(cache.path.c_str(), "ab")))
+        return;
+
+    fseek(file, 0, SEEK_END);
+    pos = ftell(file);
+    if (pos == 0)
+    {
+        uint32_t header[2] = {
+            SLANG_REFLECTION_CACHE_MAGIC, SLANG_REFLECTION_CACHE_VERSION };
+        fwrite(header, sizeof(header), 1, file);
+    }
+
+    fwrite(&key, sizeof(key), 1, file);
+    fwrite(&size, sizeof(size), 1, file);
+    fwrite(data.data(), data.size(), 1, file);
+    fclose(file);
+}
+
+void slang_reflection_cache_set_path(const char* path)
+{
+    reflection_cache& cache = get_reflection_cache();
+    std::lock_guard<std::mutex> holder{ cache.lock };
+
+    cache.path = path ? path : "";
+    cache.entries.clear();
+    cache.loaded = false;
+}
+
+slang_reflection_cache_stats slang_reflection_cache_get_stats(void)
+{
+    reflection_cache& cache = get_reflection_cache();
+    std::lock_guard<std::mutex> holder{ cache.lock };
+    slang_reflection_cache_stats stats = cache.stats;
+
+    stats.arena_allocations = arena_allocations;
+    stats.arena_bytes = arena_bytes;
+    stats.arena_blocks = arena_blocks;
+    return stats;
+}
+
+bool slang_reflect_spirv_cached(const std::vector<uint32_t>& vertex,
+    const std::vector<uint32_t>& fragment,
+    slang_reflection* reflection)
+{
+    std::vector<uint8_t> data;
+    reflection_cache& cache = get_reflection_cache();
+    auto start = std::chrono::steady_clock::now();
+    uint64_t key = slang_reflection_key(vertex, fragment, reflection);
+    bool hit = false;
+
+    {
+        std::lock_guard<std::mutex> holder{ cache.lock };
+        if (!cache.loaded)
+            slang_reflection_cache_load(cache);
+
+        auto itr = cache.entries.find(key);
+        if (itr != cache.entries.end())
+            data = itr->second;
+    }
+
+    if (!data.empty())
+    {
+        slang_reflection cached;
+        cached.texture_semantic_map = reflection->texture_semantic_map;
+        cached.texture_semantic_uniform_map = reflection->texture_semantic_uniform_map;
+        cached.semantic_map = reflection->semantic_map;
+        cached.pass_number = reflection->pass_number;
+
+        if (slang_reflection_deserialize(data.data(), data.size(), &cached))
+        {
+            *reflection = std::move(cached);
+            hit = true;
+        }
+    }
+
+    if (!hit)
+    {
+        if (!slang_reflect_spirv(vertex, fragment, reflection))
+            return false;
+        slang_reflection_serialize(*reflection, data);
+    }
+
+    {
+        std::lock_guard<std::mutex> holder{ cache.lock };
+        uint64_t usec = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        if (hit)
+        {
+            cache.stats.hits++;
+            cache.stats.hit_usec += usec;
+        }
+        else
+        {
+            cache.stats.misses++;
+            cache.stats.miss_usec += usec;
+            cache.entries[key] = data;
+            slang_reflection_cache_append(cache, key, data);
+        }
+    }
+
+    return true;
+}
@@ -18,6 +18,7 @@
 #include <vector>
 #include <unordered_map>
 #include <string>
+#include <stdint.h>
 
 /* Textures with built-in meaning. */
 enum slang_texture_semantic
@@ -139,8 +140,11 @@ struct slang_semantic_meta
     size_t ubo_offset = 0;
     size_t push_constant_offset = 0;
     unsigned num_components = 0;
+    /* Float parameters only, constant_id is the SPIR-V SpecId. */
+    uint32_t constant_id = 0;
     bool uniform = false;
     bool push_constant = false;
+    bool specialization = false;
 
     /* For APIs which need location information ala legacy GL. */
     slang_semantic_location location;
@@ -184,3 +188,37 @@ bool slang_reflect_spirv(
     const std::vector<uint32_t>& vertex,
     const std::vector<uint32_t>& fragment,
     slang_reflection* reflection);
+
+struct slang_reflection_cache_stats
+{
+    uint64_t hit_usec = 0;
+    uint64_t miss_usec = 0;
+    unsigned hits = 0;
+    unsigned misses = 0;
+    /* SPIRV-Cross containers served by the per-reflection arena,
+     * each one a malloc/free pair saved. */
+    uint64_t arena_allocations = 0;
+    uint64_t arena_bytes = 0;
+    uint64_t arena_blocks = 0;
+};
+
+/* Versioned binary form of the reflection results. The semantic map
+ * pointers and pass_number are not stored, callers keep their own. */
+void slang_reflection_serialize(const slang_reflection& reflection,
+    std::vector<uint8_t>& data);
+bool slang_reflection_deserialize(const uint8_t* data, size_t size,
+    slang_reflection* reflection);
+
+/* Same contract as slang_reflect_spirv, but results are looked up by a
+ * hash of both SPIR-V modules, the semantic maps and the pass number
+ * first, so SPIRV-Cross only runs on a miss. Thread safe. */
+bool slang_reflect_spirv_cached(
+    const std::vector<uint32_t>& vertex,
+    const std::vector<uint32_t>& fragment,
+    slang_reflection* reflection);
+
+/* File the cache is loaded from and appended to. Without a path the
+ * cache only lives for the process. */
+void slang_reflection_cache_set_path(const char* path);
+
+slang_reflection_cache_stats slang_reflection_cache_get_stats(void);
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <Windows.h>
+
+#include "startup_profile.h"
+#include "rthreads.h"
+#include "retroarch.h"
+#include "../ini.h"
+
+#define STARTUP_MAX_PHASES 128
+/* Phase handles carry the report generation in the upper bits, so a
+ * worker finishing after the next report started cannot end a phase
+ * belonging to it. */
+#define STARTUP_PHASE_BITS 8
+
+struct startup_phase
+{
+    const char* name;
+    uintptr_t thread;
+    unsigned depth;
+    int64_t start;
+    int64_t end;
+};
+
+static struct
+{
+    slock_t* lock;
+    bool active;
+    unsigned generation;
+    uintptr_t thread;
+    char reason[32];
+    char build[48];
+    int64_t start;
+    int64_t first_frame;
+    int64_t frequency;
+    unsigned num_phases;
+    struct startup_phase phases[STARTUP_MAX_PHASES];
+} startup;
+
+static int64_t startup_now(void)
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+static double startup_ms(int64_t ticks)
+{
+    return (double)ticks * 1000.0 / (double)startup.frequency;
+}
+
+static void startup_write_text(const char* path)
+{
+    unsigned i;
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return;
+
+    fprintf(file, "paraLLEl startup report\n");
+    fprintf(file, "reason: %s\nbuild: %s\n", startup.reason, startup.build);
+    fprintf(file, "first frame after: %.3f ms\n\n", startup_ms(startup.first_frame - startup.start));
+    fprintf(file, "%10s %10s  phase\n", "start ms", "length ms");
+
+    for (i = 0; i < startup.num_phases; i++)
+    {
+        const struct startup_phase* phase = &startup.phases[i];
+        fprintf(file, "%10.3f %10.3f  %*s%s%s\n",
+            startup_ms(phase->start - startup.start),
+            startup_ms(phase->end - phase->start),
+            (int)(phase->depth * 2), "", phase->name,
+            phase->thread != startup.thread ? " [worker]" : "");
+    }
+
+    fclose(file);
+}
+
+static void startup_write_json(const char* path)
+{
+    unsigned i;
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return;
+
+    fprintf(file, "{\n  \"reason\": \"%s\",\n  \"build\": \"%s\",\n", startup.reason, startup.build);
+    fprintf(file, "  \"first_frame_ms\": %.3f,\n  \"phases\": [", startup_ms(startup.first_frame - startup.start));
+
+    for (i = 0; i < startup.num_phases; i++)
+    {
+        const struct startup_phase* phase = &startup.phases[i];
+        fprintf(file, "%s\n    { \"name\": \"%s\", \"depth\": %u, \"worker\": %s, \"start_ms\": %.3f, \"duration_ms\": %.3f }",
+            i ? "," : "", phase->name, phase->depth,
+            phase->thread != startup.thread ? "true" : "false",
+            startup_ms(phase->start - startup.start),
+            startup_ms(phase->end - phase->start));
+    }
+
+    fprintf(file, "\n  ]\n}\n");
+    fclose(file);
+}
+
+/* Called with the lock held. */
+static void startup_try_finish(void)
+{
+    unsigned i;
+    char path[MAX_PATH];
+
+    if (!startup.active || !startup.first_frame)
+        return;
+
+    for (i = 0; i < startup.num_phases; i++)
+        if (!startup.phases[i].end)
+            return;
+
+    startup.active = false;
+
+    ini_get_sibling_path("startup_report.txt", path);
+    startup_write_text(path);
+    ini_get_sibling_path("startup_report.json", path);
+    startup_write_json(path);
+
+    RARCH_LOG("[Startup]: %s took %.3f ms to the first frame.\n",
+        startup.reason, startup_ms(startup.first_frame - startup.start));
+}
+
+void startup_profile_begin(const char* reason, const char* build)
+{
+    LARGE_INTEGER frequency;
+
+    if (!startup.lock)
+        startup.lock = slock_new();
+    if (!startup.lock)
+        return;
+
+    QueryPerformanceFrequency(&frequency);
+
+    slock_lock(startup.lock);
+    startup.generation++;
+    startup.active = true;
+    strncpy(startup.reason, reason, sizeof(startup.reason) - 1);
+    strncpy(startup.build, build ? build : "", sizeof(startup.build) - 1);
+    startup.frequency = frequency.QuadPart;
+    startup.num_phases = 0;
+    startup.first_frame = 0;
+    startup.thread = sthread_get_current_thread_id();
+    startup.start = startup_now();
+    slock_unlock(startup.lock);
+}
+
+unsigned startup_phase_begin(const char* name)
+{
+    unsigned i, index, handle;
+    struct startup_phase* phase;
+    uintptr_t thread = sthread_get_current_thread_id();
+
+    if (!startup.lock)
+        return STARTUP_PHASE_NONE;
+
+    slock_lock(startup.lock);
+    if (!startup.active || startup.num_phases == STARTUP_MAX_PHASES)
+    {
+        slock_unlock(startup.lock);
+        return STARTUP_PHASE_NONE;
+    }
+
+    index = startup.num_phases++;
+    phase = &startup.phases[index];
+    phase->name = name;
+    phase->thread = thread;
+    phase->depth = 0;
+    phase->end = 0;
+
+    /* Nested within whatever is still open on this thread. */
+    for (i = 0; i < index; i++)
+        if (startup.phases[i].thread == thread && !startup.phases[i].end)
+            phase->depth++;
+
+    handle = (startup.generation << STARTUP_PHASE_BITS) | index;
+    phase->start = startup_now();
+    slock_unlock(startup.lock);
+
+    return handle;
+}
+
+void startup_phase_end(unsigned phase)
+{
+    int64_t now = startup_now();
+    unsigned index = phase & ((1u << STARTUP_PHASE_BITS) - 1);
+
+    if (phase == STARTUP_PHASE_NONE || !startup.lock)
+        return;
+
+    slock_lock(startup.lock);
+    if ((phase >> STARTUP_PHASE_BITS) == (startup.generation & (~0u >> STARTUP_PHASE_BITS))
+        && index < startup.num_phases)
+    {
+        startup.phases[index].end = now;
+        startup_try_finish();
+    }
+    slock_unlock(startup.lock);
+}
+
+void startup_profile_frame(void)
+{
+    if (!startup.lock)
+        return;
+
+    slock_lock(startup.lock);
+    if (startup.active && !startup.first_frame)
+    {
+        startup.first_frame = startup_now();
+        startup_try_finish();
+    }
+    slock_unlock(startup.lock);
+}
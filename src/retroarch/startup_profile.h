@@ -0,0 +1,30 @@
+#ifndef __STARTUP_PROFILE_H
+#define __STARTUP_PROFILE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STARTUP_PHASE_NONE (~0u)
+
+/* Starts a report covering everything up to the next presented frame,
+ * e.g. RomOpen or a settings reinit. Once that frame is out and every
+ * phase has ended, the report is written next to cfg.ini as
+ * startup_report.txt and startup_report.json. */
+void startup_profile_begin(const char* reason, const char* build);
+
+/* Phases may nest and may run on worker threads. Outside of a report
+ * these are no-ops and return STARTUP_PHASE_NONE. */
+unsigned startup_phase_begin(const char* name);
+void startup_phase_end(unsigned phase);
+
+/* Call after presenting a frame. */
+void startup_profile_frame(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
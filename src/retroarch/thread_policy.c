@@ -0,0 +1,254 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+#include "thread_policy.h"
+#include "retroarch.h"
+#include "../config.h"
+
+#ifdef _MSC_VER
+#define THREAD_POLICY_TLS __declspec(thread)
+#else
+#define THREAD_POLICY_TLS _Thread_local
+#endif
+
+static const struct
+{
+    const char* name;
+    int affinity_key;
+    int priority_key;
+} thread_roles[THREAD_ROLE_COUNT] = {
+    { "executor", KEY_AFFINITY_EXECUTOR, KEY_PRIORITY_EXECUTOR },
+    { "mailbox", KEY_AFFINITY_MAILBOX, KEY_PRIORITY_MAILBOX },
+    /* Workers build things in the background, they never get boosted. */
+    { "worker", KEY_AFFINITY_WORKER, -1 },
+};
+
+/* Per thread, so concurrent workers don't need a lock. */
+static THREAD_POLICY_TLS struct
+{
+    bool entered;
+    enum thread_role role;
+    int cpu;
+    unsigned wakes;
+    unsigned migrations;
+    int64_t latency_sum_us;
+    int64_t latency_max_us;
+#ifdef _WIN32
+    HANDLE mmcss;
+#endif
+} thread_state;
+
+static int thread_policy_current_cpu(void)
+{
+#ifdef _WIN32
+    return (int)GetCurrentProcessorNumber();
+#elif defined(__linux__)
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+#ifdef _WIN32
+typedef HANDLE(WINAPI* av_set_mm_thread_characteristics_t)(LPCSTR, LPDWORD);
+typedef BOOL(WINAPI* av_revert_mm_thread_characteristics_t)(HANDLE);
+
+/* avrt.dll is loaded on demand so the plugin doesn't link against it. */
+static HMODULE thread_policy_avrt(void)
+{
+    static HMODULE avrt;
+    static bool loaded;
+    if (!loaded)
+    {
+        avrt = LoadLibraryA("avrt.dll");
+        loaded = true;
+    }
+    return avrt;
+}
+
+static void thread_policy_revert_mmcss(void)
+{
+    av_revert_mm_thread_characteristics_t revert;
+
+    if (!thread_state.mmcss)
+        return;
+
+    revert = (av_revert_mm_thread_characteristics_t)GetProcAddress(
+        thread_policy_avrt(), "AvRevertMmThreadCharacteristics");
+    if (revert)
+        revert(thread_state.mmcss);
+    thread_state.mmcss = NULL;
+}
+
+static void thread_policy_apply(const char* name, uint32_t affinity, int priority)
+{
+    static const int priorities[] = {
+        THREAD_PRIORITY_NORMAL,
+        THREAD_PRIORITY_ABOVE_NORMAL,
+        THREAD_PRIORITY_HIGHEST,
+        THREAD_PRIORITY_TIME_CRITICAL,
+    };
+    HANDLE thread = GetCurrentThread();
+    DWORD_PTR process_mask, system_mask;
+
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+        process_mask = ~(DWORD_PTR)0;
+    if (affinity && !(affinity & process_mask))
+    {
+        RARCH_LOG("[Threads]: %s affinity 0x%x has no CPU of this process, ignoring it.\n", name, affinity);
+        affinity = 0;
+    }
+    SetThreadAffinityMask(thread, affinity ? (DWORD_PTR)affinity & process_mask : process_mask);
+
+    thread_policy_revert_mmcss();
+    if (priority == THREAD_PRIORITY_LEVEL_MMCSS)
+    {
+        DWORD task_index = 0;
+        av_set_mm_thread_characteristics_t set_characteristics =
+            (av_set_mm_thread_characteristics_t)GetProcAddress(
+                thread_policy_avrt(), "AvSetMmThreadCharacteristicsA");
+
+        if (set_characteristics)
+            thread_state.mmcss = set_characteristics("Games", &task_index);
+        if (thread_state.mmcss)
+            priority = THREAD_PRIORITY_LEVEL_DEFAULT;
+        else
+        {
+            RARCH_LOG("[Threads]: MMCSS is unavailable, running %s at highest priority.\n", name);
+            priority = 2;
+        }
+    }
+
+    if (priority < 0 || priority >= (int)(sizeof(priorities) / sizeof(priorities[0])))
+        priority = THREAD_PRIORITY_LEVEL_DEFAULT;
+    SetThreadPriority(thread, priorities[priority]);
+}
+#else
+static void thread_policy_apply(const char* name, uint32_t affinity, int priority)
+{
+    struct sched_param param;
+    int policy = SCHED_OTHER;
+
+#ifdef __linux__
+    {
+        unsigned i;
+        cpu_set_t set;
+
+        CPU_ZERO(&set);
+        for (i = 0; i < 32; i++)
+            if (!affinity || (affinity & (1u << i)))
+                CPU_SET(i, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0 && affinity)
+            RARCH_LOG("[Threads]: Failed to set %s affinity 0x%x.\n", name, affinity);
+    }
+#endif
+
+    memset(&param, 0, sizeof(param));
+    if (priority >= 3)
+        policy = SCHED_FIFO;
+    else if (priority == 2)
+        policy = SCHED_RR;
+    if (policy != SCHED_OTHER)
+        param.sched_priority = sched_get_priority_min(policy);
+
+    /* Real-time classes usually need privileges, fall back quietly. */
+    if (pthread_setschedparam(pthread_self(), policy, &param) != 0 && policy != SCHED_OTHER)
+        RARCH_LOG("[Threads]: No permission for real-time scheduling of %s.\n", name);
+}
+#endif
+
+void thread_policy_enter(enum thread_role role)
+{
+    uint32_t affinity;
+    int priority;
+
+    if (role >= THREAD_ROLE_COUNT)
+        return;
+
+    affinity = (uint32_t)settings[thread_roles[role].affinity_key].val;
+    priority = thread_roles[role].priority_key >= 0
+        ? settings[thread_roles[role].priority_key].val
+        : THREAD_PRIORITY_LEVEL_DEFAULT;
+
+    thread_policy_apply(thread_roles[role].name, affinity, priority);
+
+    if (!thread_state.entered || thread_state.role != role)
+    {
+        thread_state.wakes = 0;
+        thread_state.migrations = 0;
+        thread_state.latency_sum_us = 0;
+        thread_state.latency_max_us = 0;
+    }
+    thread_state.entered = true;
+    thread_state.role = role;
+    thread_state.cpu = thread_policy_current_cpu();
+}
+
+void thread_policy_leave(void)
+{
+    if (!thread_state.entered)
+        return;
+
+    if (thread_state.wakes)
+        RARCH_LOG("[Threads]: %s woke %u times, %u on a different CPU, wake latency %.1f us average, %lld us max.\n",
+            thread_roles[thread_state.role].name, thread_state.wakes, thread_state.migrations,
+            (double)thread_state.latency_sum_us / thread_state.wakes,
+            (long long)thread_state.latency_max_us);
+
+    /* Pool threads, e.g. behind std::async, outlive the role. */
+    thread_policy_apply(thread_roles[thread_state.role].name, 0, THREAD_PRIORITY_LEVEL_DEFAULT);
+    thread_state.entered = false;
+}
+
+int64_t thread_policy_now_us(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
+
+    if (!frequency.QuadPart)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    return now.QuadPart / frequency.QuadPart * 1000000
+        + now.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+void thread_policy_wake(int64_t signalled_us)
+{
+    int cpu;
+    int64_t latency;
+
+    if (!thread_state.entered)
+        return;
+
+    cpu = thread_policy_current_cpu();
+    if (cpu != thread_state.cpu)
+        thread_state.migrations++;
+    thread_state.cpu = cpu;
+
+    latency = thread_policy_now_us() - signalled_us;
+    if (latency < 0)
+        latency = 0;
+    thread_state.wakes++;
+    thread_state.latency_sum_us += latency;
+    if (latency > thread_state.latency_max_us)
+        thread_state.latency_max_us = latency;
+}
@@ -0,0 +1,48 @@
+#ifndef __THREAD_POLICY_H
+#define __THREAD_POLICY_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum thread_role
+{
+    /* Runs every plugin call, i.e. the RDP frontend and presentation. */
+    THREAD_ROLE_EXECUTOR = 0,
+    /* Emulated mailbox swapchain acquire. */
+    THREAD_ROLE_MAILBOX,
+    /* Pipeline warm-up, filter chain and RDP frontend builds. */
+    THREAD_ROLE_WORKER,
+    THREAD_ROLE_COUNT
+};
+
+/* Placement comes from the KEY_AFFINITY_* and KEY_PRIORITY_* settings,
+ * which live in this machine's cfg.ini. An affinity of 0 leaves the
+ * thread on every CPU of the process. Priorities:
+ * 0 OS default, 1 above normal, 2 highest, 3 time critical and
+ * 4 MMCSS "Games" (SCHED_RR for 2 and SCHED_FIFO for 3/4 on pthreads). */
+#define THREAD_PRIORITY_LEVEL_DEFAULT 0
+#define THREAD_PRIORITY_LEVEL_MMCSS 4
+
+/* Applies the role's placement to the calling thread. Calling it again
+ * re-applies the current settings. */
+void thread_policy_enter(enum thread_role role);
+
+/* Logs what was observed since thread_policy_enter and puts the thread
+ * back on the OS default placement. */
+void thread_policy_leave(void);
+
+/* Timestamp for thread_policy_wake, taken when waking the thread. */
+int64_t thread_policy_now_us(void);
+
+/* Records one wake of the calling thread: the latency from the signal
+ * to now and whether it came back on a different CPU. */
+void thread_policy_wake(int64_t signalled_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -20,6 +20,7 @@
 #include "compat_strl.h"
 
 #include "driver.h"
+#include "startup_profile.h"
 
 #include <string.h>
 
@@ -90,6 +91,14 @@ bool video_driver_get_viewport_info(struct video_viewport* viewport)
     return true;
 }
 
+bool video_driver_read_viewport(uint8_t* buffer, bool is_idle)
+{
+    video_driver_state_t* video_st = &video_driver_st;
+    if (!video_st->current_video || !video_st->current_video->read_viewport)
+        return false;
+    return video_st->current_video->read_viewport(video_st->data, buffer, is_idle);
+}
+
 static bool get_metrics_null(void* data, enum display_metric_types type,
     float* value) {
     return false;
@@ -134,6 +143,7 @@ bool video_driver_init_internal(bool* video_is_threaded, bool verbosity_enabled)
     video_driver_state_t* video_st = &video_driver_st;
     struct retro_game_geometry* geom = &video_st->av_info.geometry;
     int video_driver_pix_fmt = 0;
+    unsigned phase;
     settings_t* settings = config_get_ptr();
 
     video_viewport_t video_viewport_custom;
@@ -176,7 +186,9 @@ bool video_driver_init_internal(bool* video_is_threaded, bool verbosity_enabled)
     video_driver_find_driver(settings,
         "video driver", verbosity_enabled);
 
+    phase = startup_phase_begin("video_driver.init");
     video_st->data = video_st->current_video->init(&video);
+    startup_phase_end(phase);
 
     if (!video_st->data)
     {
@@ -542,6 +554,35 @@ uintptr_t video_driver_get_current_framebuffer(void)
     return 0;
 }
 
+void video_driver_set_filtering(unsigned index,
+    bool smooth, bool ctx_scaling)
+{
+    video_driver_state_t* video_st = &video_driver_st;
+    if (video_st->poke
+        && video_st->poke->set_filtering)
+        video_st->poke->set_filtering(video_st->data,
+            index, smooth, ctx_scaling);
+}
+
+void video_driver_set_nonblock_state(bool toggle)
+{
+    video_driver_state_t* video_st = &video_driver_st;
+    settings_t* settings = config_get_ptr();
+    if (video_st->current_video
+        && video_st->current_video->set_nonblock_state)
+        video_st->current_video->set_nonblock_state(video_st->data,
+            toggle, settings->bools.video_adaptive_vsync,
+            settings->uints.video_swap_interval);
+}
+
+void video_driver_apply_state_changes(void)
+{
+    video_driver_state_t* video_st = &video_driver_st;
+    if (video_st->poke
+        && video_st->poke->apply_state_changes)
+        video_st->poke->apply_state_changes(video_st->data);
+}
+
 retro_proc_address_t video_driver_get_proc_address(const char* sym)
 {
     video_driver_state_t* video_st = &video_driver_st;
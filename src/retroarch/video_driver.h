@@ -683,6 +683,11 @@ void video_driver_set_size(unsigned width, unsigned height);
 
 float video_driver_get_aspect_ratio(void);
 
+bool video_driver_get_viewport_info(struct video_viewport* viewport);
+
+/* Reads the last presented viewport as bottom-up BGR24. */
+bool video_driver_read_viewport(uint8_t* buffer, bool is_idle);
+
 bool video_context_driver_get_refresh_rate(float* refresh_rate);
 
 const struct retro_hw_render_context_negotiation_interface
@@ -709,6 +714,12 @@ uintptr_t video_driver_get_current_framebuffer(void);
 
 retro_proc_address_t video_driver_get_proc_address(const char* sym);
 
+void video_driver_set_filtering(unsigned index, bool smooth, bool ctx_scaling);
+
+void video_driver_set_nonblock_state(bool toggle);
+
+void video_driver_apply_state_changes(void);
+
 void video_driver_frame(const void* data, unsigned width,
     unsigned height, size_t pitch);
 
@@ -0,0 +1,515 @@
+#include "vulkan_allocator.h"
+
+#include "retroarch.h"
+#include "rthreads.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Free ranges of a block, kept sorted by offset so that
+ * neighbours can be merged on release. */
+struct vk_free_range
+{
+    VkDeviceSize offset;
+    VkDeviceSize size;
+};
+
+struct vk_alloc_block
+{
+    struct vk_alloc_block* next;
+    struct vk_free_range* ranges;
+    VkDeviceSize size;           /* uint64_t alignment */
+    VkDeviceSize used;
+    void* mapped;
+    VkDeviceMemory memory;       /* ptr alignment */
+    unsigned num_ranges;
+    unsigned cap_ranges;
+    unsigned allocations;
+};
+
+struct vk_allocator
+{
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    struct vk_alloc_block* blocks[VK_MAX_MEMORY_TYPES];
+    slock_t* lock;
+    VkDevice device;             /* ptr alignment */
+    VkDeviceSize granularity;    /* uint64_t alignment */
+    /* Only touched with lock held. */
+    uint64_t dedicated_bytes;
+    unsigned dedicated;
+    unsigned device_allocations;
+};
+
+static VkDeviceSize vulkan_align(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static bool vulkan_allocator_device_alloc(struct vk_allocator* allocator,
+    VkDeviceSize size, uint32_t memory_type,
+    const void* pnext, VkDeviceMemory* memory, void** mapped)
+{
+    VkMemoryAllocateInfo alloc = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+
+    alloc.pNext = pnext;
+    alloc.allocationSize = size;
+    alloc.memoryTypeIndex = memory_type;
+
+    if (vkAllocateMemory(allocator->device, &alloc, NULL, memory) != VK_SUCCESS)
+        return false;
+
+    *mapped = NULL;
+
+    if (allocator->memory_properties.memoryTypes[memory_type].propertyFlags &
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        vkMapMemory(allocator->device, *memory, 0, VK_WHOLE_SIZE, 0, mapped);
+
+    return true;
+}
+
+static struct vk_alloc_block* vulkan_allocator_new_block(
+    struct vk_allocator* allocator, uint32_t memory_type)
+{
+    struct vk_alloc_block* block = (struct vk_alloc_block*)
+        calloc(1, sizeof(*block));
+    if (!block)
+        return NULL;
+
+    block->cap_ranges = 16;
+    block->ranges = (struct vk_free_range*)
+        malloc(block->cap_ranges * sizeof(*block->ranges));
+    block->size = VULKAN_ALLOCATOR_BLOCK_SIZE;
+
+    if (!block->ranges || !vulkan_allocator_device_alloc(allocator,
+        block->size, memory_type, NULL, &block->memory, &block->mapped))
+    {
+        free(block->ranges);
+        free(block);
+        return NULL;
+    }
+
+    allocator->device_allocations++;
+
+    block->ranges[0].offset = 0;
+    block->ranges[0].size = block->size;
+    block->num_ranges = 1;
+
+    block->next = allocator->blocks[memory_type];
+    allocator->blocks[memory_type] = block;
+
+    RARCH_LOG("[Vulkan]: Allocated %u MiB block for memory type %u.\n",
+        (unsigned)(block->size >> 20), memory_type);
+    return block;
+}
+
+static void vulkan_allocator_free_block(struct vk_allocator* allocator,
+    struct vk_alloc_block* block)
+{
+    if (block->mapped)
+        vkUnmapMemory(allocator->device, block->memory);
+    vkFreeMemory(allocator->device, block->memory, NULL);
+    free(block->ranges);
+    free(block);
+}
+
+/* Best fit over the free ranges. Returns the offset or
+ * VK_WHOLE_SIZE if nothing fits. */
+static VkDeviceSize vulkan_block_suballoc(struct vk_alloc_block* block,
+    VkDeviceSize size, VkDeviceSize alignment)
+{
+    unsigned i;
+    unsigned best = block->num_ranges;
+    VkDeviceSize best_waste = VK_WHOLE_SIZE;
+    VkDeviceSize offset, head, tail;
+    struct vk_free_range* range;
+
+    for (i = 0; i < block->num_ranges; i++)
+    {
+        VkDeviceSize start = vulkan_align(block->ranges[i].offset, alignment);
+        VkDeviceSize end = block->ranges[i].offset + block->ranges[i].size;
+
+        if (start + size <= end && end - start - size < best_waste)
+        {
+            best = i;
+            best_waste = end - start - size;
+            if (!best_waste)
+                break;
+        }
+    }
+
+    if (best == block->num_ranges)
+        return VK_WHOLE_SIZE;
+
+    range = &block->ranges[best];
+    offset = vulkan_align(range->offset, alignment);
+    head = offset - range->offset;
+    tail = range->size - head - size;
+
+    if (head && tail)
+    {
+        /* Split in two, keeping both the alignment
+         * padding and the remainder free. */
+        if (block->num_ranges == block->cap_ranges)
+        {
+            struct vk_free_range* ranges = (struct vk_free_range*)realloc(
+                block->ranges, 2 * block->cap_ranges * sizeof(*ranges));
+            if (!ranges)
+                return VK_WHOLE_SIZE;
+            block->ranges = ranges;
+            block->cap_ranges *= 2;
+            range = &block->ranges[best];
+        }
+
+        memmove(range + 2, range + 1,
+            (block->num_ranges - best - 1) * sizeof(*range));
+        block->num_ranges++;
+
+        range[0].size = head;
+        range[1].offset = offset + size;
+        range[1].size = tail;
+    }
+    else if (head)
+        range->size = head;
+    else if (tail)
+    {
+        range->offset = offset + size;
+        range->size = tail;
+    }
+    else
+    {
+        memmove(range, range + 1,
+            (block->num_ranges - best - 1) * sizeof(*range));
+        block->num_ranges--;
+    }
+
+    block->used += size;
+    block->allocations++;
+    return offset;
+}
+
+static void vulkan_block_release(struct vk_alloc_block* block,
+    VkDeviceSize offset, VkDeviceSize size)
+{
+    unsigned i;
+    bool merge_prev, merge_next;
+
+    /* Find the first range after the released one. */
+    for (i = 0; i < block->num_ranges; i++)
+        if (block->ranges[i].offset > offset)
+            break;
+
+    merge_prev = i > 0 &&
+        block->ranges[i - 1].offset + block->ranges[i - 1].size == offset;
+    merge_next = i < block->num_ranges &&
+        offset + size == block->ranges[i].offset;
+
+    if (merge_prev && merge_next)
+    {
+        block->ranges[i - 1].size += size + block->ranges[i].size;
+        memmove(&block->ranges[i], &block->ranges[i + 1],
+            (block->num_ranges - i - 1) * sizeof(*block->ranges));
+        block->num_ranges--;
+    }
+    else if (merge_prev)
+        block->ranges[i - 1].size += size;
+    else if (merge_next)
+    {
+        block->ranges[i].offset = offset;
+        block->ranges[i].size += size;
+    }
+    else
+    {
+        if (block->num_ranges == block->cap_ranges)
+        {
+            struct vk_free_range* ranges = (struct vk_free_range*)realloc(
+                block->ranges, 2 * block->cap_ranges * sizeof(*ranges));
+            /* Leaking the range is preferable to corrupting the list. */
+            if (!ranges)
+                return;
+            block->ranges = ranges;
+            block->cap_ranges *= 2;
+        }
+
+        memmove(&block->ranges[i + 1], &block->ranges[i],
+            (block->num_ranges - i) * sizeof(*block->ranges));
+        block->ranges[i].offset = offset;
+        block->ranges[i].size = size;
+        block->num_ranges++;
+    }
+
+    block->used -= size;
+    block->allocations--;
+}
+
+static bool vulkan_allocator_alloc(struct vk_allocator* allocator,
+    const VkMemoryRequirements* reqs, bool dedicated,
+    const VkMemoryDedicatedAllocateInfo* dedicated_info,
+    uint32_t memory_type, struct vk_allocation* allocation)
+{
+    struct vk_alloc_block* block;
+    bool new_block = false;
+    /* Rounding to the granularity keeps linear and optimal
+     * resources from ever sharing a page. */
+    VkDeviceSize alignment = MAX(reqs->alignment, allocator->granularity);
+    VkDeviceSize size = vulkan_align(reqs->size, allocator->granularity);
+
+    VkMemoryPropertyFlags flags =
+        allocator->memory_properties.memoryTypes[memory_type].propertyFlags;
+
+    memset(allocation, 0, sizeof(*allocation));
+    allocation->allocator = allocator;
+    allocation->memory_type = memory_type;
+
+    /* Non-coherent memory is flushed and invalidated as a whole,
+     * which must not touch ranges owned by someone else. */
+    if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+        !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+        dedicated = true;
+
+    if (dedicated || size > VULKAN_ALLOCATOR_BLOCK_SIZE)
+    {
+        if (!vulkan_allocator_device_alloc(allocator, reqs->size,
+            memory_type, dedicated_info,
+            &allocation->memory, &allocation->mapped))
+            return false;
+
+        allocation->size = reqs->size;
+
+        slock_lock(allocator->lock);
+        allocator->device_allocations++;
+        allocator->dedicated++;
+        allocator->dedicated_bytes += reqs->size;
+        slock_unlock(allocator->lock);
+        return true;
+    }
+
+    slock_lock(allocator->lock);
+
+    for (block = allocator->blocks[memory_type]; block; block = block->next)
+    {
+        VkDeviceSize offset = vulkan_block_suballoc(block, size, alignment);
+        if (offset != VK_WHOLE_SIZE)
+        {
+            allocation->offset = offset;
+            break;
+        }
+    }
+
+    if (!block)
+    {
+        block = vulkan_allocator_new_block(allocator, memory_type);
+        if (block)
+        {
+            allocation->offset = vulkan_block_suballoc(block, size, alignment);
+            new_block = true;
+        }
+    }
+
+    slock_unlock(allocator->lock);
+
+    if (new_block)
+        vulkan_allocator_log_stats(allocator);
+
+    if (!block || allocation->offset == VK_WHOLE_SIZE)
+        return false;
+
+    allocation->size = size;
+    allocation->block = block;
+    allocation->memory = block->memory;
+    if (block->mapped)
+        allocation->mapped = (uint8_t*)block->mapped + allocation->offset;
+    return true;
+}
+
+bool vulkan_allocator_alloc_image(struct vk_allocator* allocator,
+    VkImage image, uint32_t memory_type,
+    struct vk_allocation* allocation)
+{
+    VkImageMemoryRequirementsInfo2 info = {
+       VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2 };
+    VkMemoryDedicatedRequirements dedicated = {
+       VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS };
+    VkMemoryRequirements2 reqs = { VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2 };
+    VkMemoryDedicatedAllocateInfo dedicated_info = {
+       VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO };
+
+    info.image = image;
+    reqs.pNext = &dedicated;
+    vkGetImageMemoryRequirements2(allocator->device, &info, &reqs);
+
+    dedicated_info.image = image;
+    if (!vulkan_allocator_alloc(allocator, &reqs.memoryRequirements,
+        dedicated.requiresDedicatedAllocation, &dedicated_info,
+        memory_type, allocation))
+        return false;
+
+    vkBindImageMemory(allocator->device, image,
+        allocation->memory, allocation->offset);
+    return true;
+}
+
+bool vulkan_allocator_alloc_buffer(struct vk_allocator* allocator,
+    VkBuffer buffer, uint32_t memory_type,
+    struct vk_allocation* allocation)
+{
+    VkBufferMemoryRequirementsInfo2 info = {
+       VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2 };
+    VkMemoryDedicatedRequirements dedicated = {
+       VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS };
+    VkMemoryRequirements2 reqs = { VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2 };
+    VkMemoryDedicatedAllocateInfo dedicated_info = {
+       VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO };
+
+    info.buffer = buffer;
+    reqs.pNext = &dedicated;
+    vkGetBufferMemoryRequirements2(allocator->device, &info, &reqs);
+
+    dedicated_info.buffer = buffer;
+    if (!vulkan_allocator_alloc(allocator, &reqs.memoryRequirements,
+        dedicated.requiresDedicatedAllocation, &dedicated_info,
+        memory_type, allocation))
+        return false;
+
+    vkBindBufferMemory(allocator->device, buffer,
+        allocation->memory, allocation->offset);
+    return true;
+}
+
+void vulkan_allocator_release(struct vk_allocation* allocation)
+{
+    struct vk_allocator* allocator = allocation->allocator;
+    struct vk_alloc_block* block = allocation->block;
+
+    if (!allocator || allocation->memory == VK_NULL_HANDLE)
+        return;
+
+    if (!block)
+    {
+        if (allocation->mapped)
+            vkUnmapMemory(allocator->device, allocation->memory);
+        vkFreeMemory(allocator->device, allocation->memory, NULL);
+
+        slock_lock(allocator->lock);
+        allocator->dedicated--;
+        allocator->dedicated_bytes -= allocation->size;
+        slock_unlock(allocator->lock);
+    }
+    else
+    {
+        slock_lock(allocator->lock);
+        vulkan_block_release(block, allocation->offset, allocation->size);
+
+        /* Keep the first block of each type around even when empty,
+         * resizes free and reallocate straight away. */
+        if (!block->allocations &&
+            block != allocator->blocks[allocation->memory_type])
+        {
+            struct vk_alloc_block** it = &allocator->blocks[allocation->memory_type];
+            while (*it != block)
+                it = &(*it)->next;
+            *it = block->next;
+            vulkan_allocator_free_block(allocator, block);
+        }
+        slock_unlock(allocator->lock);
+    }
+
+    memset(allocation, 0, sizeof(*allocation));
+}
+
+void vulkan_allocator_get_stats(struct vk_allocator* allocator,
+    struct vk_allocator_stats* stats)
+{
+    unsigned type, i;
+
+    memset(stats, 0, sizeof(*stats));
+
+    slock_lock(allocator->lock);
+    for (type = 0; type < VK_MAX_MEMORY_TYPES; type++)
+    {
+        struct vk_alloc_block* block;
+        for (block = allocator->blocks[type]; block; block = block->next)
+        {
+            stats->blocks++;
+            stats->reserved += block->size;
+            stats->used += block->used;
+            stats->allocations += block->allocations;
+
+            for (i = 0; i < block->num_ranges; i++)
+            {
+                stats->total_free += block->ranges[i].size;
+                if (block->ranges[i].size > stats->largest_free)
+                    stats->largest_free = block->ranges[i].size;
+            }
+        }
+    }
+
+    stats->reserved += allocator->dedicated_bytes;
+    stats->used += allocator->dedicated_bytes;
+    stats->dedicated = allocator->dedicated;
+    stats->allocations += allocator->dedicated;
+    stats->device_allocations = allocator->device_allocations;
+    slock_unlock(allocator->lock);
+}
+
+void vulkan_allocator_log_stats(struct vk_allocator* allocator)
+{
+    struct vk_allocator_stats stats;
+    unsigned fragmentation = 0;
+
+    vulkan_allocator_get_stats(allocator, &stats);
+
+    /* Share of free memory not in the largest hole. */
+    if (stats.total_free)
+        fragmentation = (unsigned)(100 -
+            (stats.largest_free * 100) / stats.total_free);
+
+    RARCH_LOG("[Vulkan]: Allocator: %u KiB used of %u KiB, %u allocation(s) in %u block(s) + %u dedicated, %u%% fragmented, %u vkAllocateMemory call(s).\n",
+        (unsigned)(stats.used >> 10),
+        (unsigned)(stats.reserved >> 10),
+        stats.allocations, stats.blocks, stats.dedicated,
+        fragmentation, stats.device_allocations);
+}
+
+struct vk_allocator* vulkan_allocator_new(VkDevice device,
+    const VkPhysicalDeviceMemoryProperties* memory_properties,
+    VkDeviceSize buffer_image_granularity)
+{
+    struct vk_allocator* allocator = (struct vk_allocator*)
+        calloc(1, sizeof(*allocator));
+    if (!allocator)
+        return NULL;
+
+    allocator->device = device;
+    allocator->memory_properties = *memory_properties;
+    allocator->granularity = buffer_image_granularity
+        ? buffer_image_granularity : 1;
+    allocator->lock = slock_new();
+    return allocator;
+}
+
+void vulkan_allocator_free(struct vk_allocator* allocator)
+{
+    unsigned type;
+
+    if (!allocator)
+        return;
+
+    vulkan_allocator_log_stats(allocator);
+
+    for (type = 0; type < VK_MAX_MEMORY_TYPES; type++)
+    {
+        struct vk_alloc_block* block = allocator->blocks[type];
+        while (block)
+        {
+            struct vk_alloc_block* next = block->next;
+            if (block->allocations)
+                RARCH_LOG("[Vulkan]: Allocator: %u allocation(s) leaked in memory type %u.\n",
+                    block->allocations, type);
+            vulkan_allocator_free_block(allocator, block);
+            block = next;
+        }
+    }
+
+    slock_free(allocator->lock);
+    free(allocator);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "volk.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Default size of a VkDeviceMemory block which smaller
+ * images and buffers are carved out of. */
+#define VULKAN_ALLOCATOR_BLOCK_SIZE (32 * 1024 * 1024)
+
+struct vk_allocator;
+struct vk_alloc_block;
+
+struct vk_allocation
+{
+    VkDeviceSize offset;          /* uint64_t alignment */
+    VkDeviceSize size;
+    /* Host pointer to offset, NULL unless the type is HOST_VISIBLE.
+     * Blocks stay mapped for their whole lifetime. */
+    void* mapped;
+    VkDeviceMemory memory;        /* ptr alignment */
+    struct vk_allocator* allocator;
+    /* NULL for dedicated allocations. */
+    struct vk_alloc_block* block;
+    uint32_t memory_type;
+};
+
+struct vk_allocator_stats
+{
+    uint64_t reserved;      /* Bytes held in VkDeviceMemory. */
+    uint64_t used;          /* Bytes handed out. */
+    uint64_t total_free;    /* Free bytes inside blocks. */
+    uint64_t largest_free;  /* Largest contiguous free range. */
+    unsigned blocks;
+    unsigned dedicated;
+    unsigned allocations;
+    unsigned device_allocations; /* vkAllocateMemory calls so far. */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    struct vk_allocator* vulkan_allocator_new(VkDevice device,
+        const VkPhysicalDeviceMemoryProperties* memory_properties,
+        VkDeviceSize buffer_image_granularity);
+
+    void vulkan_allocator_free(struct vk_allocator* allocator);
+
+    /* Allocates memory of the given type for the object and binds it.
+     * A dedicated VkDeviceMemory is only used when the driver requires
+     * one, the object is larger than a block, or the type is not
+     * HOST_COHERENT (flushes are done over the whole VkDeviceMemory). */
+    bool vulkan_allocator_alloc_image(struct vk_allocator* allocator,
+        VkImage image, uint32_t memory_type,
+        struct vk_allocation* allocation);
+
+    bool vulkan_allocator_alloc_buffer(struct vk_allocator* allocator,
+        VkBuffer buffer, uint32_t memory_type,
+        struct vk_allocation* allocation);
+
+    /* Safe to call on a zeroed allocation. */
+    void vulkan_allocator_release(struct vk_allocation* allocation);
+
+    void vulkan_allocator_get_stats(struct vk_allocator* allocator,
+        struct vk_allocator_stats* stats);
+
+    void vulkan_allocator_log_stats(struct vk_allocator* allocator);
+
+#ifdef __cplusplus
+}
+#endif
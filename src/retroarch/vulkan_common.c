@@ -18,6 +18,8 @@
 
 #include "string_list.h"
 #include "vulkan_common.h"
+#include "startup_profile.h"
+#include "thread_policy.h"
 #include "compat_strl.h"
 #include "stdio.h"
 
@@ -122,7 +124,12 @@ static void vulkan_emulated_mailbox_deinit(
     }
 
     if (mailbox->lock)
+    {
+        unsigned spun, slept;
+        slock_get_contention(mailbox->lock, &spun, &slept);
+        RARCH_LOG("[Vulkan]: Mailbox lock contended %u times, %u of them slept.\n", spun + slept, slept);
         slock_free(mailbox->lock);
+    }
     if (mailbox->cond)
         scond_free(mailbox->cond);
 
@@ -140,6 +147,7 @@ static VkResult vulkan_emulated_mailbox_acquire_next_image(
     if (!mailbox->has_pending_request)
     {
         mailbox->request_acquire = true;
+        mailbox->requested_us = thread_policy_now_us();
         scond_signal(mailbox->cond);
     }
 
@@ -168,6 +176,7 @@ static VkResult vulkan_emulated_mailbox_acquire_next_image_blocking(
     if (!mailbox->has_pending_request)
     {
         mailbox->request_acquire = true;
+        mailbox->requested_us = thread_policy_now_us();
         scond_signal(mailbox->cond);
     }
 
@@ -201,6 +210,7 @@ static void vulkan_emulated_mailbox_loop(void* userdata)
     info.flags = 0;
 
     vkCreateFence(mailbox->device, &info, NULL, &fence);
+    thread_policy_enter(THREAD_ROLE_MAILBOX);
 
     for (;;)
     {
@@ -214,6 +224,7 @@ static void vulkan_emulated_mailbox_loop(void* userdata)
             break;
         }
 
+        thread_policy_wake(mailbox->requested_us);
         mailbox->request_acquire = false;
         slock_unlock(mailbox->lock);
 
@@ -242,6 +253,7 @@ static void vulkan_emulated_mailbox_loop(void* userdata)
         }
     }
 
+    thread_policy_leave();
     vkDestroyFence(mailbox->device, fence, NULL);
 }
 
@@ -545,38 +557,24 @@ struct vk_texture vulkan_create_texture(vk_t* vk,
             vkDestroyBuffer(vk->context->device, old->buffer, NULL);
     }
 
-    /* We can pilfer the old memory and move it over to the new texture. */
-    if (old &&
-        old->memory_size >= mem_reqs.size &&
-        old->memory_type == alloc.memoryTypeIndex)
-    {
-        tex.memory = old->memory;
-        tex.memory_size = old->memory_size;
-        tex.memory_type = old->memory_type;
-
-        if (old->mapped)
-            vkUnmapMemory(device, old->memory);
-
-        old->memory = VK_NULL_HANDLE;
-    }
-    else
-    {
-        vkAllocateMemory(device, &alloc, NULL, &tex.memory);
-        tex.memory_size = alloc.allocationSize;
-        tex.memory_type = alloc.memoryTypeIndex;
-    }
-
+    /* Hand the old range back first, a resize of the same
+     * texture will then usually land in the same spot. */
     if (old)
     {
-        if (old->memory != VK_NULL_HANDLE)
-            vkFreeMemory(device, old->memory, NULL);
+        vulkan_allocator_release(&old->allocation);
         memset(old, 0, sizeof(*old));
     }
 
     if (tex.image)
-        vkBindImageMemory(device, tex.image, tex.memory, 0);
-    if (tex.buffer)
-        vkBindBufferMemory(device, tex.buffer, tex.memory, 0);
+        vulkan_allocator_alloc_image(vk->context->allocator,
+            tex.image, alloc.memoryTypeIndex, &tex.allocation);
+    else if (tex.buffer)
+        vulkan_allocator_alloc_buffer(vk->context->allocator,
+            tex.buffer, alloc.memoryTypeIndex, &tex.allocation);
+
+    tex.memory = tex.allocation.memory;
+    tex.memory_size = tex.allocation.size;
+    tex.memory_type = tex.allocation.memory_type;
 
     if (type != VULKAN_TEXTURE_STAGING && type != VULKAN_TEXTURE_READBACK)
     {
@@ -632,13 +630,10 @@ struct vk_texture vulkan_create_texture(vk_t* vk,
             unsigned y;
             uint8_t* dst = NULL;
             const uint8_t* src = NULL;
-            void* ptr = NULL;
             unsigned bpp = vulkan_format_to_bpp(tex.format);
             unsigned stride = tex.width * bpp;
 
-            vkMapMemory(device, tex.memory, tex.offset, tex.size, 0, &ptr);
-
-            dst = (uint8_t*)ptr;
+            dst = (uint8_t*)tex.allocation.mapped + tex.offset;
             src = (const uint8_t*)initial;
             for (y = 0; y < tex.height; y++, dst += tex.stride, src += stride)
                 memcpy(dst, src, width * bpp);
@@ -646,7 +641,6 @@ struct vk_texture vulkan_create_texture(vk_t* vk,
             if (tex.need_manual_cache_management &&
                 tex.memory != VK_NULL_HANDLE)
                 VULKAN_SYNC_TEXTURE_TO_GPU(vk->context->device, tex.memory);
-            vkUnmapMemory(device, tex.memory);
         }
         break;
         case VULKAN_TEXTURE_STATIC:
@@ -809,16 +803,13 @@ void vulkan_destroy_texture(
     VkDevice device,
     struct vk_texture* tex)
 {
-    if (tex->mapped)
-        vkUnmapMemory(device, tex->memory);
     if (tex->view)
         vkDestroyImageView(device, tex->view, NULL);
     if (tex->image)
         vkDestroyImage(device, tex->image, NULL);
     if (tex->buffer)
         vkDestroyBuffer(device, tex->buffer, NULL);
-    if (tex->memory)
-        vkFreeMemory(device, tex->memory, NULL);
+    vulkan_allocator_release(&tex->allocation);
 
 #ifdef VULKAN_DEBUG_TEXTURE_ALLOC
     if (tex->image)
@@ -844,49 +835,69 @@ void vulkan_destroy_texture(
     tex->layout = VK_IMAGE_LAYOUT_UNDEFINED;
 }
 
-static void vulkan_write_quad_descriptors(
-    VkDevice device,
-    VkDescriptorSet set,
+static VkDescriptorSet vulkan_get_quad_descriptor_set(
+    vk_t* vk,
     VkBuffer buffer,
     VkDeviceSize offset,
     VkDeviceSize range,
     const struct vk_texture* texture,
     VkSampler sampler)
 {
-    VkWriteDescriptorSet write;
-    VkDescriptorBufferInfo buffer_info;
+    struct vk_quad_descriptor_data data;
 
-    buffer_info.buffer = buffer;
-    buffer_info.offset = offset;
-    buffer_info.range = range;
-
-    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    write.pNext = NULL;
-    write.dstSet = set;
-    write.dstBinding = 0;
-    write.dstArrayElement = 0;
-    write.descriptorCount = 1;
-    write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    write.pImageInfo = NULL;
-    write.pBufferInfo = &buffer_info;
-    write.pTexelBufferView = NULL;
-    vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+    /* Zeroed so padding is stable for hashing and comparison. */
+    memset(&data, 0, sizeof(data));
+    data.buffer.buffer = buffer;
+    data.buffer.offset = offset;
+    data.buffer.range = range;
 
     if (texture)
     {
-        VkDescriptorImageInfo image_info;
+        data.image.sampler = sampler;
+        data.image.imageView = texture->view;
+        data.image.imageLayout = texture->layout;
+    }
 
-        image_info.sampler = sampler;
-        image_info.imageView = texture->view;
-        image_info.imageLayout = texture->layout;
+    return vulkan_descriptor_manager_get_quad_set(
+        vk->context->device,
+        &vk->chain->descriptor_manager,
+        vk->pipelines.quad_templates,
+        &data);
+}
 
-        write.dstSet = set;
-        write.dstBinding = 1;
-        write.descriptorCount = 1;
-        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        write.pImageInfo = &image_info;
-        vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+/* Uploads uniform data for a draw, reusing the previous upload when
+ * the contents are the same. Repeated MVPs then produce identical
+ * bindings and hit the descriptor cache. */
+static bool vulkan_upload_uniform(vk_t* vk,
+    const void* data, size_t size,
+    struct vk_buffer_range* range)
+{
+    if (vk->tracker.ubo.data
+        && vk->tracker.ubo_size == size
+        && string_is_equal_fast(vk->tracker.ubo_data, data, size))
+    {
+        *range = vk->tracker.ubo;
+        return true;
     }
+
+    if (!vulkan_buffer_ring_alloc(vk->context, &vk->ubo_ring,
+        &vk->chain->ubo, size, range))
+        return false;
+
+    memcpy(range->data, data, size);
+
+    /* Larger uploads are never reused. */
+    if (size > sizeof(vk->tracker.ubo_data))
+    {
+        vk->tracker.ubo.data = NULL;
+        vk->tracker.ubo_size = 0;
+        return true;
+    }
+
+    memcpy(vk->tracker.ubo_data, data, size);
+    vk->tracker.ubo = *range;
+    vk->tracker.ubo_size = size;
+    return true;
 }
 
 void vulkan_transition_texture(vk_t* vk, VkCommandBuffer cmd, struct vk_texture* texture)
@@ -944,6 +955,8 @@ static void vulkan_check_dynamic_state(vk_t* vk)
 
 void vulkan_draw_triangles(vk_t* vk, const struct vk_draw_triangles* call)
 {
+    vulkan_batch_flush(vk);
+
     if (call->texture)
         vulkan_transition_texture(vk, vk->cmd, call->texture);
 
@@ -967,19 +980,11 @@ void vulkan_draw_triangles(vk_t* vk, const struct vk_draw_triangles* call)
         struct vk_buffer_range range;
         float* mvp_data_ptr = NULL;
 
-        if (!vulkan_buffer_chain_alloc(vk->context, &vk->chain->ubo,
+        if (!vulkan_upload_uniform(vk, call->uniform,
             call->uniform_size, &range))
             return;
 
-        memcpy(range.data, call->uniform, call->uniform_size);
-
-        set = vulkan_descriptor_manager_alloc(
-            vk->context->device,
-            &vk->chain->descriptor_manager);
-
-        vulkan_write_quad_descriptors(
-            vk->context->device,
-            set,
+        set = vulkan_get_quad_descriptor_set(vk,
             range.buffer,
             range.offset,
             call->uniform_size,
@@ -1006,10 +1011,13 @@ void vulkan_draw_triangles(vk_t* vk, const struct vk_draw_triangles* call)
 
     /* Draw the quad */
     vkCmdDraw(vk->cmd, call->vertices, 1, 0, 0);
+    vk->draw_stats.draws++;
 }
 
 void vulkan_draw_quad(vk_t* vk, const struct vk_draw_quad* quad)
 {
+    vulkan_batch_flush(vk);
+
     vulkan_transition_texture(vk, vk->cmd, quad->texture);
 
     if (quad->pipeline != vk->tracker.pipeline)
@@ -1028,14 +1036,9 @@ void vulkan_draw_quad(vk_t* vk, const struct vk_draw_quad* quad)
     /* Upload descriptors */
     {
         VkDescriptorSet set;
-        struct vk_buffer_range range;
-
-        if (!vulkan_buffer_chain_alloc(vk->context, &vk->chain->ubo,
-            sizeof(*quad->mvp), &range))
-            return;
 
         if (
-            string_is_equal_fast(quad->mvp,
+            !string_is_equal_fast(quad->mvp,
                 &vk->tracker.mvp, sizeof(*quad->mvp))
             || quad->texture->view != vk->tracker.view
             || quad->sampler != vk->tracker.sampler)
@@ -1043,19 +1046,11 @@ void vulkan_draw_quad(vk_t* vk, const struct vk_draw_quad* quad)
             /* Upload UBO */
             struct vk_buffer_range range;
 
-            if (!vulkan_buffer_chain_alloc(vk->context, &vk->chain->ubo,
+            if (!vulkan_upload_uniform(vk, quad->mvp,
                 sizeof(*quad->mvp), &range))
                 return;
 
-            memcpy(range.data, quad->mvp, sizeof(*quad->mvp));
-
-            set = vulkan_descriptor_manager_alloc(
-                vk->context->device,
-                &vk->chain->descriptor_manager);
-
-            vulkan_write_quad_descriptors(
-                vk->context->device,
-                set,
+            set = vulkan_get_quad_descriptor_set(vk,
                 range.buffer,
                 range.offset,
                 sizeof(*quad->mvp),
@@ -1075,8 +1070,8 @@ void vulkan_draw_quad(vk_t* vk, const struct vk_draw_quad* quad)
     /* Upload VBO */
     {
         struct vk_buffer_range range;
-        if (!vulkan_buffer_chain_alloc(vk->context, &vk->chain->vbo,
-            6 * sizeof(struct vk_vertex), &range))
+        if (!vulkan_buffer_ring_alloc(vk->context, &vk->vbo_ring,
+            &vk->chain->vbo, 6 * sizeof(struct vk_vertex), &range))
             return;
 
         {
@@ -1092,6 +1087,79 @@ void vulkan_draw_quad(vk_t* vk, const struct vk_draw_quad* quad)
 
     /* Draw the quad */
     vkCmdDraw(vk->cmd, 6, 1, 0, 0);
+    vk->draw_stats.draws++;
+}
+
+void vulkan_batch_quad(vk_t* vk, VkPipeline pipeline,
+    struct vk_texture* texture, VkSampler sampler,
+    const struct vk_batch_quad* quad)
+{
+    struct vk_vertex* pv;
+
+    if (vk->batch.quads &&
+        (pipeline != vk->batch.pipeline
+         || texture != vk->batch.texture
+         || sampler != vk->batch.sampler))
+        vulkan_batch_flush(vk);
+
+    if (vk->batch.quads == vk->batch.capacity)
+    {
+        unsigned capacity = vk->batch.capacity ? vk->batch.capacity * 2 : 64;
+        struct vk_vertex* vertices = (struct vk_vertex*)realloc(
+            vk->batch.vertices, 6 * capacity * sizeof(struct vk_vertex));
+        if (!vertices)
+            return;
+        vk->batch.vertices = vertices;
+        vk->batch.capacity = capacity;
+    }
+
+    vk->batch.pipeline = pipeline;
+    vk->batch.texture = texture;
+    vk->batch.sampler = sampler;
+
+    pv = &vk->batch.vertices[6 * vk->batch.quads++];
+    VULKAN_WRITE_QUAD_VBO(pv, quad->x, quad->y, quad->width, quad->height,
+        quad->tex_x, quad->tex_y, quad->tex_width, quad->tex_height,
+        &quad->color);
+    vk->batch.batched++;
+}
+
+void vulkan_batch_flush(vk_t* vk)
+{
+    struct vk_draw_triangles call;
+    struct vk_buffer_range range;
+    unsigned vertices = 6 * vk->batch.quads;
+
+    if (!vertices)
+        return;
+    /* Cleared first, vulkan_draw_triangles flushes as well. */
+    vk->batch.quads = 0;
+
+    if (!vulkan_buffer_ring_alloc(vk->context, &vk->vbo_ring,
+        &vk->chain->vbo, vertices * sizeof(struct vk_vertex), &range))
+        return;
+    memcpy(range.data, vk->batch.vertices, vertices * sizeof(struct vk_vertex));
+
+    call.vertices = vertices;
+    call.uniform_size = sizeof(vk->mvp_no_rot);
+    call.uniform = &vk->mvp_no_rot;
+    call.vbo = &range;
+    call.texture = vk->batch.texture;
+    call.pipeline = vk->batch.pipeline;
+    call.sampler = vk->batch.sampler;
+    vulkan_draw_triangles(vk, &call);
+    vk->batch.draws++;
+}
+
+void vulkan_batch_free(vk_t* vk)
+{
+    if (vk->batch.draws)
+        RARCH_LOG("[Vulkan]: Batched %llu quads into %llu draws.\n",
+            (unsigned long long)vk->batch.batched,
+            (unsigned long long)vk->batch.draws);
+
+    free(vk->batch.vertices);
+    memset(&vk->batch, 0, sizeof(vk->batch));
 }
 
 struct vk_buffer vulkan_create_buffer(
@@ -1101,7 +1169,6 @@ struct vk_buffer vulkan_create_buffer(
     struct vk_buffer buffer;
     VkMemoryRequirements mem_reqs;
     VkBufferCreateInfo info;
-    VkMemoryAllocateInfo alloc;
 
     info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     info.pNext = NULL;
@@ -1115,21 +1182,17 @@ struct vk_buffer vulkan_create_buffer(
 
     vkGetBufferMemoryRequirements(context->device, buffer.buffer, &mem_reqs);
 
-    alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    alloc.pNext = NULL;
-    alloc.allocationSize = mem_reqs.size;
-    alloc.memoryTypeIndex = vulkan_find_memory_type(
-        &context->memory_properties,
-        mem_reqs.memoryTypeBits,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    vkAllocateMemory(context->device, &alloc, NULL, &buffer.memory);
-    vkBindBufferMemory(context->device, buffer.buffer, buffer.memory, 0);
+    vulkan_allocator_alloc_buffer(context->allocator, buffer.buffer,
+        vulkan_find_memory_type(
+            &context->memory_properties,
+            mem_reqs.memoryTypeBits,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+        &buffer.allocation);
 
     buffer.size = size;
-
-    vkMapMemory(context->device,
-        buffer.memory, 0, buffer.size, 0, &buffer.mapped);
+    buffer.memory = buffer.allocation.memory;
+    buffer.mapped = buffer.allocation.mapped;
     return buffer;
 }
 
@@ -1137,10 +1200,8 @@ void vulkan_destroy_buffer(
     VkDevice device,
     struct vk_buffer* buffer)
 {
-    vkUnmapMemory(device, buffer->memory);
-    vkFreeMemory(device, buffer->memory, NULL);
-
     vkDestroyBuffer(device, buffer->buffer, NULL);
+    vulkan_allocator_release(&buffer->allocation);
 
     memset(buffer, 0, sizeof(*buffer));
 }
@@ -1159,7 +1220,9 @@ static struct vk_descriptor_pool* vulkan_alloc_descriptor_pool(
 
     pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     pool_info.pNext = NULL;
-    pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    /* Sets are never freed individually; they are handed out
+     * linearly each frame and reused after VK_DESCRIPTOR_MANAGER_RESTART. */
+    pool_info.flags = 0;
     pool_info.maxSets = VULKAN_DESCRIPTOR_MANAGER_BLOCK_SETS;
     pool_info.poolSizeCount = manager->num_sizes;
     pool_info.pPoolSizes = manager->sizes;
@@ -1187,24 +1250,61 @@ static struct vk_descriptor_pool* vulkan_alloc_descriptor_pool(
 VkDescriptorSet vulkan_descriptor_manager_alloc(
     VkDevice device, struct vk_descriptor_manager* manager)
 {
+    manager->stats.allocs++;
+
     if (manager->count < VULKAN_DESCRIPTOR_MANAGER_BLOCK_SETS)
         return manager->current->sets[manager->count++];
 
-    while (manager->current->next)
+    if (!manager->current->next)
     {
-        manager->current = manager->current->next;
-        manager->count = 0;
-        return manager->current->sets[manager->count++];
+        manager->current->next = vulkan_alloc_descriptor_pool(device, manager);
+        retro_assert(manager->current->next);
+        manager->num_pools++;
     }
 
-    manager->current->next = vulkan_alloc_descriptor_pool(device, manager);
-    retro_assert(manager->current->next);
-
     manager->current = manager->current->next;
     manager->count = 0;
     return manager->current->sets[manager->count++];
 }
 
+VkDescriptorSet vulkan_descriptor_manager_get_quad_set(
+    VkDevice device,
+    struct vk_descriptor_manager* manager,
+    const VkDescriptorUpdateTemplate* templates,
+    const struct vk_quad_descriptor_data* data)
+{
+    unsigned i;
+    VkDescriptorSet set;
+    struct vk_descriptor_cache_entry* entry;
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint32_t hash = 2166136261u;
+
+    for (i = 0; i < sizeof(*data); i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+
+    entry = &manager->cache[hash & (VULKAN_DESCRIPTOR_MANAGER_CACHE_SIZE - 1)];
+
+    /* A set written earlier this frame with the same bindings
+     * can be bound again as-is. */
+    if (entry->frame == manager->frame
+        && string_is_equal_fast(&entry->data, data, sizeof(*data)))
+    {
+        manager->stats.hits++;
+        return entry->set;
+    }
+
+    set = vulkan_descriptor_manager_alloc(device, manager);
+
+    vkUpdateDescriptorSetWithTemplate(device, set,
+        templates[data->image.imageView != VK_NULL_HANDLE], data);
+    manager->stats.writes++;
+
+    entry->data = *data;
+    entry->set = set;
+    entry->frame = manager->frame;
+    return set;
+}
+
 struct vk_descriptor_manager vulkan_create_descriptor_manager(
     VkDevice device,
     const VkDescriptorPoolSize* sizes,
@@ -1216,8 +1316,11 @@ struct vk_descriptor_manager vulkan_create_descriptor_manager(
 
     retro_assert(num_sizes <= VULKAN_MAX_DESCRIPTOR_POOL_SIZES);
 
+    memset(&manager, 0, sizeof(manager));
     manager.current = NULL;
     manager.count = 0;
+    /* Cache entries start at frame 0, so never treat them as live. */
+    manager.frame = 1;
 
     for (i = 0; i < VULKAN_MAX_DESCRIPTOR_POOL_SIZES; i++)
     {
@@ -1229,6 +1332,8 @@ struct vk_descriptor_manager vulkan_create_descriptor_manager(
     manager.num_sizes = num_sizes;
 
     manager.head = vulkan_alloc_descriptor_pool(device, &manager);
+    manager.current = manager.head;
+    manager.num_pools = 1;
     retro_assert(manager.head);
     return manager;
 }
@@ -1239,12 +1344,18 @@ void vulkan_destroy_descriptor_manager(
 {
     struct vk_descriptor_pool* node = manager->head;
 
+    if (manager->stats.allocs)
+        RARCH_LOG("[Vulkan]: Descriptor manager: %u pool(s), %llu set(s) handed out, %llu written, %llu reused from cache.\n",
+            manager->num_pools,
+            (unsigned long long)manager->stats.allocs,
+            (unsigned long long)manager->stats.writes,
+            (unsigned long long)manager->stats.hits);
+
     while (node)
     {
         struct vk_descriptor_pool* next = node->next;
 
-        vkFreeDescriptorSets(device, node->pool,
-            VULKAN_DESCRIPTOR_MANAGER_BLOCK_SETS, node->sets);
+        /* Destroying the pool releases its sets. */
         vkDestroyDescriptorPool(device, node->pool, NULL);
 
         free(node);
@@ -1370,6 +1481,92 @@ void vulkan_buffer_chain_free(
     memset(chain, 0, sizeof(*chain));
 }
 
+bool vulkan_buffer_ring_init(const struct vulkan_context* context,
+    struct vk_buffer_ring* ring, VkDeviceSize size,
+    VkDeviceSize alignment, VkBufferUsageFlags usage)
+{
+    memset(ring, 0, sizeof(*ring));
+    ring->alignment = alignment ? alignment : 1;
+    ring->frame_index = VULKAN_MAX_SWAPCHAIN_IMAGES;
+
+    /* Keep the size a multiple of the alignment so that wrapping
+     * a monotonic position never breaks alignment. */
+    size = (size + ring->alignment - 1) & ~(ring->alignment - 1);
+    ring->buffer = vulkan_create_buffer(context, size, usage);
+    return ring->buffer.mapped != NULL;
+}
+
+void vulkan_buffer_ring_begin_frame(struct vk_buffer_ring* ring,
+    unsigned frame_index)
+{
+    /* Close the previous frame. */
+    if (ring->frame_index < VULKAN_MAX_SWAPCHAIN_IMAGES)
+        ring->frame_end[ring->frame_index] = ring->head;
+
+    /* The last frame which used this index has completed,
+     * so its watermark is the new tail. */
+    if (ring->frame_end[frame_index] > ring->tail)
+        ring->tail = ring->frame_end[frame_index];
+
+    ring->frame_index = frame_index;
+    ring->frame_start = ring->head;
+}
+
+bool vulkan_buffer_ring_alloc(const struct vulkan_context* context,
+    struct vk_buffer_ring* ring, struct vk_buffer_chain* overflow,
+    size_t size, struct vk_buffer_range* range)
+{
+    VkDeviceSize ring_size = ring->buffer.size;
+    uint64_t start = (ring->head + ring->alignment - 1)
+        & ~(ring->alignment - 1);
+    VkDeviceSize offset = ring_size ? start % ring_size : 0;
+
+    /* Allocations never straddle the end; skip to the next lap. */
+    if (offset + size > ring_size)
+    {
+        start += ring_size - offset;
+        offset = 0;
+    }
+
+    if (size <= ring_size && start + size - ring->tail <= ring_size)
+    {
+        range->buffer = ring->buffer.buffer;
+        range->offset = offset;
+        range->data = (uint8_t*)ring->buffer.mapped + offset;
+        ring->head = start + size;
+
+        if (ring->head - ring->frame_start > ring->peak_frame)
+            ring->peak_frame = ring->head - ring->frame_start;
+        if (ring->head - ring->tail > ring->peak_in_flight)
+            ring->peak_in_flight = ring->head - ring->tail;
+        return true;
+    }
+
+    if (!ring->overflows++)
+        RARCH_LOG("[Vulkan]: Buffer ring of %u KiB exhausted, spilling to chained buffers.\n",
+            (unsigned)(ring_size >> 10));
+
+    return vulkan_buffer_chain_alloc(context, overflow, size, range);
+}
+
+void vulkan_buffer_ring_free(VkDevice device,
+    struct vk_buffer_ring* ring, const char* name)
+{
+    if (ring->buffer.buffer != VK_NULL_HANDLE)
+    {
+        RARCH_LOG("[Vulkan]: %s ring: %u KiB, peak %u KiB per frame, %u KiB in flight, %u overflow(s).\n",
+            name,
+            (unsigned)(ring->buffer.size >> 10),
+            (unsigned)(ring->peak_frame >> 10),
+            (unsigned)(ring->peak_in_flight >> 10),
+            ring->overflows);
+
+        vulkan_destroy_buffer(device, &ring->buffer);
+    }
+
+    memset(ring, 0, sizeof(*ring));
+}
+
 static bool vulkan_find_extensions(const char** exts, unsigned num_exts,
     const VkExtensionProperties* properties, unsigned property_count)
 {
@@ -1544,6 +1741,65 @@ static bool vulkan_context_init_gpu(gfx_ctx_vulkan_data_t* vk)
     return true;
 }
 
+/* Budgets are queried from the physical device, so only support
+ * matters, not whether the device was created with the extension. */
+static void vulkan_context_init_memory_budget(gfx_ctx_vulkan_data_t* vk)
+{
+    uint32_t property_count = 0;
+    VkExtensionProperties* properties = NULL;
+    static const char* memory_budget[] = { "VK_EXT_memory_budget" };
+
+    vk->context.memory_budget = false;
+
+    if (vkEnumerateDeviceExtensionProperties(vk->context.gpu, NULL,
+        &property_count, NULL) != VK_SUCCESS || !property_count)
+        return;
+
+    properties = (VkExtensionProperties*)malloc(property_count * sizeof(*properties));
+    if (!properties)
+        return;
+
+    if (vkEnumerateDeviceExtensionProperties(vk->context.gpu, NULL,
+        &property_count, properties) == VK_SUCCESS)
+        vk->context.memory_budget = vulkan_find_extensions(memory_budget, 1,
+            properties, property_count);
+
+    free(properties);
+}
+
+void vulkan_get_vram_usage(const struct vulkan_context* context,
+    uint64_t* used, uint64_t* budget)
+{
+    unsigned i;
+    struct vk_allocator_stats stats;
+
+    *used = 0;
+    *budget = 0;
+
+    if (context->memory_budget)
+    {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_props = {
+           VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT };
+        VkPhysicalDeviceMemoryProperties2 props = {
+           VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2 };
+
+        props.pNext = &budget_props;
+        vkGetPhysicalDeviceMemoryProperties2(context->gpu, &props);
+
+        for (i = 0; i < props.memoryProperties.memoryHeapCount; i++)
+        {
+            if (!(props.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+                continue;
+            *used += budget_props.heapUsage[i];
+            *budget += budget_props.heapBudget[i];
+        }
+        return;
+    }
+
+    vulkan_allocator_get_stats(context->allocator, &stats);
+    *used = stats.reserved;
+}
+
 static bool vulkan_context_init_device(gfx_ctx_vulkan_data_t* vk)
 {
     bool use_device_ext;
@@ -1780,6 +2036,17 @@ static bool vulkan_context_init_device(gfx_ctx_vulkan_data_t* vk)
     vkGetDeviceQueue(vk->context.device,
         vk->context.graphics_queue_index, 0, &vk->context.queue);
 
+    vulkan_context_init_memory_budget(vk);
+
+    vk->context.allocator = vulkan_allocator_new(vk->context.device,
+        &vk->context.memory_properties,
+        vk->context.gpu_properties.limits.bufferImageGranularity);
+    if (!vk->context.allocator)
+    {
+        RARCH_ERR("[Vulkan]: Failed to create memory allocator.\n");
+        return false;
+    }
+
 #ifdef HAVE_THREADS
     vk->context.queue_lock = slock_new();
     if (!vk->context.queue_lock)
@@ -1903,7 +2170,11 @@ bool vulkan_context_init(gfx_ctx_vulkan_data_t* vk,
         res = VK_SUCCESS;
     }
     else
+    {
+        unsigned phase = startup_phase_begin("vkCreateInstance");
         res = vkCreateInstance(&info, NULL, &vk->context.instance);
+        startup_phase_end(phase);
+    }
 
 #ifdef VULKAN_DEBUG
     VULKAN_SYMBOL_WRAPPER_LOAD_INSTANCE_EXTENSION_SYMBOL(vk->context.instance,
@@ -2174,6 +2445,9 @@ bool vulkan_surface_create(gfx_ctx_vulkan_data_t* vk,
     unsigned width, unsigned height,
     unsigned swap_interval)
 {
+    unsigned phase;
+    bool ok;
+
     switch (type)
     {
     case VULKAN_WSI_WAYLAND:
@@ -2363,11 +2637,16 @@ bool vulkan_surface_create(gfx_ctx_vulkan_data_t* vk,
     }
 
     /* Must create device after surface since we need to be able to query queues to use for presentation. */
-    if (!vulkan_context_init_device(vk))
+    phase = startup_phase_begin("vulkan_context_init_device");
+    ok = vulkan_context_init_device(vk);
+    startup_phase_end(phase);
+    if (!ok)
         return false;
 
-    if (!vulkan_create_swapchain(
-        vk, width, height, swap_interval))
+    phase = startup_phase_begin("vulkan_create_swapchain");
+    ok = vulkan_create_swapchain(vk, width, height, swap_interval);
+    startup_phase_end(phase);
+    if (!ok)
         return false;
 
     vulkan_acquire_next_image(vk);
@@ -2436,9 +2715,7 @@ void vulkan_present(gfx_ctx_vulkan_data_t* vk, unsigned index)
     present.pResults = &result;
 
     /* Better hope QueuePresent doesn't block D: */
-#ifdef HAVE_THREADS
-    slock_lock(vk->context.queue_lock);
-#endif
+    vulkan_queue_lock(&vk->context, VULKAN_QUEUE_HOLDER_PRESENT);
     err = vkQueuePresentKHR(vk->context.queue, &present);
 
     /* VK_SUBOPTIMAL_KHR can be returned on
@@ -2460,11 +2737,46 @@ void vulkan_present(gfx_ctx_vulkan_data_t* vk, unsigned index)
         vulkan_destroy_swapchain(vk);
     }
 
+    vulkan_queue_unlock(&vk->context, VULKAN_QUEUE_HOLDER_PRESENT);
+}
+
+void vulkan_queue_lock(vulkan_context_t* context, enum vulkan_queue_holder holder)
+{
+#ifdef HAVE_THREADS
+    slock_lock(context->queue_lock);
+#endif
+    context->queue_hold[holder].locked_us = thread_policy_now_us();
+}
+
+void vulkan_queue_unlock(vulkan_context_t* context, enum vulkan_queue_holder holder)
+{
+    int64_t held = thread_policy_now_us() - context->queue_hold[holder].locked_us;
+
+    context->queue_hold[holder].count++;
+    context->queue_hold[holder].total_us += held;
+    if (held > context->queue_hold[holder].max_us)
+        context->queue_hold[holder].max_us = held;
 #ifdef HAVE_THREADS
-    slock_unlock(vk->context.queue_lock);
+    slock_unlock(context->queue_lock);
 #endif
 }
 
+void vulkan_log_queue_holds(vulkan_context_t* context)
+{
+    static const char* names[VULKAN_QUEUE_HOLDER_COUNT] = { "core", "frame", "present" };
+    unsigned i;
+
+    for (i = 0; i < VULKAN_QUEUE_HOLDER_COUNT; i++)
+    {
+        if (!context->queue_hold[i].count)
+            continue;
+        RARCH_LOG("[Vulkan]: Queue lock held by %s %u times, %.1f us average, %lld us max.\n",
+            names[i], context->queue_hold[i].count,
+            (double)context->queue_hold[i].total_us / context->queue_hold[i].count,
+            (long long)context->queue_hold[i].max_us);
+    }
+}
+
 void vulkan_context_destroy(gfx_ctx_vulkan_data_t* vk,
     bool destroy_surface)
 {
@@ -2476,6 +2788,9 @@ void vulkan_context_destroy(gfx_ctx_vulkan_data_t* vk,
 
     vulkan_destroy_swapchain(vk);
 
+    vulkan_allocator_free(vk->context.allocator);
+    vk->context.allocator = NULL;
+
     if (destroy_surface && vk->vk_surface != VK_NULL_HANDLE)
     {
         vkDestroySurfaceKHR(vk->context.instance,
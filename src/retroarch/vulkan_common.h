@@ -15,9 +15,12 @@
 
 #pragma once
 
-#define VULKAN_DESCRIPTOR_MANAGER_BLOCK_SETS    16
+#define VULKAN_DESCRIPTOR_MANAGER_BLOCK_SETS    64
+#define VULKAN_DESCRIPTOR_MANAGER_CACHE_SIZE    64
 #define VULKAN_MAX_DESCRIPTOR_POOL_SIZES        16
 #define VULKAN_BUFFER_BLOCK_SIZE                (64 * 1024)
+#define VULKAN_BUFFER_RING_SIZE                 (1024 * 1024)
+#define VULKAN_TRACKER_UBO_SIZE                 256
 
 #define VULKAN_MAX_SWAPCHAIN_IMAGES             8
 
@@ -32,6 +35,7 @@
 #include "video_driver.h"
 #include "scaler.h"
 #include "matrix_4x4.h"
+#include "vulkan_allocator.h"
 
 enum vk_texture_type
 {
@@ -54,6 +58,16 @@ enum vk_texture_type
     VULKAN_TEXTURE_READBACK
 };
 
+/* Who holds queue_lock, for the hold time statistics. */
+enum vulkan_queue_holder
+{
+    /* lock_queue/unlock_queue of the hw render interface. */
+    VULKAN_QUEUE_HOLDER_CORE = 0,
+    VULKAN_QUEUE_HOLDER_FRAME,
+    VULKAN_QUEUE_HOLDER_PRESENT,
+    VULKAN_QUEUE_HOLDER_COUNT
+};
+
 enum vulkan_wsi_type
 {
     VULKAN_WSI_NONE = 0,
@@ -93,7 +107,17 @@ typedef struct ALIGN(16)
 typedef struct vulkan_context
 {
     slock_t* queue_lock;
+    /* Only touched with queue_lock held. */
+    struct
+    {
+        int64_t locked_us;
+        int64_t total_us;
+        int64_t max_us;
+        unsigned count;
+    } queue_hold[VULKAN_QUEUE_HOLDER_COUNT];
     retro_vulkan_destroy_device_t destroy_device;   /* ptr alignment */
+    /* Backs all vk_texture and vk_buffer memory. */
+    struct vk_allocator* allocator;
 
     VkInstance instance;
     VkPhysicalDevice gpu;
@@ -118,6 +142,9 @@ typedef struct vulkan_context
 #ifdef VULKAN_DEBUG
     VkDebugReportCallbackEXT debug_callback;
 #endif
+    /* The physical device reports VK_EXT_memory_budget heaps. */
+    bool memory_budget;
+
     uint32_t graphics_queue_index;
     uint32_t num_swapchain_images;
     uint32_t current_swapchain_index;
@@ -149,6 +176,8 @@ struct vulkan_emulated_mailbox
     VkDevice device;              /* ptr alignment */
     VkSwapchainKHR swapchain;     /* ptr alignment */
 
+    /* When request_acquire was set, for wake latency. */
+    int64_t requested_us;
     unsigned index;
     VkResult result;              /* enum alignment */
     bool acquired;
@@ -211,6 +240,7 @@ struct vk_image
 struct vk_texture
 {
     VkDeviceSize memory_size;     /* uint64_t alignment */
+    struct vk_allocation allocation; /* uint64_t alignment */
 
     void* mapped;
     VkImage image;                /* ptr alignment */
@@ -235,6 +265,7 @@ struct vk_texture
 struct vk_buffer
 {
     VkDeviceSize size;      /* uint64_t alignment */
+    struct vk_allocation allocation; /* uint64_t alignment */
     void* mapped;
     VkBuffer buffer;        /* ptr alignment */
     VkDeviceMemory memory;  /* ptr alignment */
@@ -256,6 +287,25 @@ struct vk_buffer_chain
     VkBufferUsageFlags usage; /* uint32_t alignment */
 };
 
+/* One persistently mapped buffer shared by all frames in flight.
+ * Positions are monotonic and wrap modulo the buffer size; each frame
+ * records where its allocations ended, and once that frame's fence has
+ * been waited on, everything before that watermark may be overwritten. */
+struct vk_buffer_ring
+{
+    struct vk_buffer buffer; /* uint64_t alignment */
+    VkDeviceSize alignment;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t frame_start;
+    uint64_t frame_end[VULKAN_MAX_SWAPCHAIN_IMAGES];
+    /* Telemetry for sizing the ring. */
+    uint64_t peak_frame;
+    uint64_t peak_in_flight;
+    unsigned overflows;
+    unsigned frame_index;
+};
+
 struct vk_buffer_range
 {
     VkDeviceSize offset; /* uint64_t alignment */
@@ -270,14 +320,40 @@ struct vk_descriptor_pool
     VkDescriptorSet sets[VULKAN_DESCRIPTOR_MANAGER_BLOCK_SETS]; /* ptr alignment */
 };
 
+/* Matches the two-binding quad layout: UBO at 0, texture at 1.
+ * Laid out for vkUpdateDescriptorSetWithTemplate. */
+struct vk_quad_descriptor_data
+{
+    VkDescriptorBufferInfo buffer; /* uint64_t alignment */
+    VkDescriptorImageInfo image;   /* ptr alignment */
+};
+
+struct vk_descriptor_cache_entry
+{
+    struct vk_quad_descriptor_data data; /* uint64_t alignment */
+    VkDescriptorSet set;                 /* ptr alignment */
+    uint32_t frame;
+};
+
 struct vk_descriptor_manager
 {
     struct vk_descriptor_pool* head;
     struct vk_descriptor_pool* current;
     VkDescriptorSetLayout set_layout; /* ptr alignment */
     VkDescriptorPoolSize sizes[VULKAN_MAX_DESCRIPTOR_POOL_SIZES]; /* uint32_t alignment */
+    /* Sets written this frame, direct-mapped by binding hash.
+     * An entry is only live if its frame matches the manager's. */
+    struct vk_descriptor_cache_entry cache[VULKAN_DESCRIPTOR_MANAGER_CACHE_SIZE];
+    struct
+    {
+        uint64_t allocs;
+        uint64_t writes;
+        uint64_t hits;
+    } stats;
+    uint32_t frame;
     unsigned count;
     unsigned num_sizes;
+    unsigned num_pools;
 };
 
 struct vk_per_frame
@@ -344,16 +420,44 @@ typedef struct vk
     struct vk_image backbuffers[VULKAN_MAX_SWAPCHAIN_IMAGES];
     struct vk_texture default_texture;
 
+    /* Streamed vertex and uniform data. The per-frame chains only
+     * take allocations which don't fit in the ring. */
+    struct vk_buffer_ring vbo_ring;
+    struct vk_buffer_ring ubo_ring;
+
     /* Currently active command buffer. */
     VkCommandBuffer cmd;
     /* Staging pool for doing buffer transfers on GPU. */
     VkCommandPool staging_pool;
 
+    struct
+    {
+        /* Filter chain rebuilt off-thread, vulkan_frame swaps it in
+         * at the next frame boundary once the worker is done. */
+        sthread_t* thread;
+        struct vk_filter_chain_job* job;
+        /* Settings changed again while a build was in flight. */
+        bool rebuild;
+    } filter_swap;
+
+    struct
+    {
+        /* Pipelines and the default filter chain are built here while
+         * the core starts up, vulkan_warmup_wait joins it before use. */
+        sthread_t* thread;
+        bool filter_chain_ok;
+    } warmup;
+
     struct
     {
         struct scaler_ctx scaler_bgr;
         struct scaler_ctx scaler_rgb;
         struct vk_texture staging[VULKAN_MAX_SWAPCHAIN_IMAGES];
+        /* Frames since the last read_viewport while streaming, streaming
+         * stops once nobody has asked for a while. */
+        unsigned idle_frames;
+        /* Staging buffers written since streaming was last enabled. */
+        bool fresh[VULKAN_MAX_SWAPCHAIN_IMAGES];
         bool pending;
         bool streamed;
     } readback;
@@ -375,6 +479,8 @@ typedef struct vk
         VkPipeline hdr;
 #endif /* VULKAN_HDR_SWAPCHAIN */
         VkDescriptorSetLayout set_layout;
+        /* Quad descriptor writes: [0] UBO only, [1] UBO + texture. */
+        VkDescriptorUpdateTemplate quad_templates[2];
         VkPipelineLayout layout;
         VkPipelineCache cache;
     } pipelines;
@@ -383,9 +489,25 @@ typedef struct vk
     {
         VkPipeline pipelines[8 * 2];
         struct vk_texture blank_texture;
+        /* R8 atlas of the built-in glyphs, see vulkan_batch_text. */
+        struct vk_texture glyphs;
         bool blend;
     } display;
 
+    /* Quads sharing pipeline, texture and sampler, drawn together on
+     * the next change or vulkan_batch_flush. */
+    struct
+    {
+        struct vk_vertex* vertices;
+        struct vk_texture* texture;
+        VkPipeline pipeline; /* ptr alignment */
+        VkSampler sampler;   /* ptr alignment */
+        uint64_t batched;
+        uint64_t draws;
+        unsigned quads;
+        unsigned capacity;
+    } batch;
+
 #ifdef VULKAN_HDR_SWAPCHAIN
     struct
     {
@@ -430,6 +552,9 @@ typedef struct vk
         unsigned capacity_cmd;
         unsigned last_width;
         unsigned last_height;
+        /* Wait value of semaphores[0] when it is a timeline, else 0. */
+        uint64_t wait_value;
+
         uint32_t num_semaphores;
         uint32_t num_cmd;
         uint32_t src_queue_family;
@@ -445,10 +570,25 @@ typedef struct vk
         VkImageView view;    /* ptr alignment */
         VkSampler sampler;   /* ptr alignment */
         math_matrix_4x4 mvp;
+        /* Last uniform upload, reused when the contents repeat so
+         * identical draws land on the same cached descriptor set.
+         * ubo_data is a CPU copy, the ring memory may be write-combined
+         * and too slow to read back. */
+        struct vk_buffer_range ubo;
+        size_t ubo_size;
+        uint8_t ubo_data[VULKAN_TRACKER_UBO_SIZE];
         VkRect2D scissor;    /* int32_t alignment */
         bool use_scissor;
     } tracker;
 
+    /* Everything composited on top of the core's frame goes through
+     * vulkan_draw_triangles/vulkan_draw_quad. */
+    struct
+    {
+        uint64_t frames;
+        uint64_t draws;
+    } draw_stats;
+
     bool vsync;
     bool keep_aspect;
     bool fullscreen;
@@ -513,11 +653,13 @@ typedef struct vk
 { \
    manager->current = manager->head; \
    manager->count = 0; \
+   manager->frame++; \
 }
 
+/* Allocator blocks stay mapped, so this only resolves the pointer. */
 #define VK_MAP_PERSISTENT_TEXTURE(device, texture) \
 { \
-   vkMapMemory(device, texture->memory, texture->offset, texture->size, 0, &texture->mapped); \
+   texture->mapped = (uint8_t*)texture->allocation.mapped + texture->offset; \
 }
 
 #define VULKAN_PASS_SET_TEXTURE(device, set, _sampler, binding, image_view, image_layout) \
@@ -664,10 +806,38 @@ typedef struct vk
 void vulkan_draw_quad(vk_t* vk, const struct vk_draw_quad* quad);
 
 /* The VBO needs to be written to before calling this.
- * Use vulkan_buffer_chain_alloc.
+ * Use vulkan_buffer_ring_alloc.
  */
 void vulkan_draw_triangles(vk_t* vk, const struct vk_draw_triangles* call);
 
+struct vk_batch_quad
+{
+    /* Normalized to the viewport the batch is drawn with,
+     * origin at the top left. */
+    float x, y, width, height;
+    float tex_x, tex_y, tex_width, tex_height;
+    struct vk_color color;
+};
+
+/* Queues a quad drawn with vk->mvp_no_rot. Pending quads are drawn before
+ * any other vulkan_draw_* call, and must be flushed before the render
+ * pass ends or the viewport changes. */
+void vulkan_batch_quad(vk_t* vk, VkPipeline pipeline,
+    struct vk_texture* texture, VkSampler sampler,
+    const struct vk_batch_quad* quad);
+
+void vulkan_batch_flush(vk_t* vk);
+
+void vulkan_batch_free(vk_t* vk);
+
+/* Queues text in the built-in glyphs, each glyph pixel being scale
+ * viewport pixels. Lowercase is drawn as uppercase. Returns the width
+ * in the same normalized units as x. */
+float vulkan_batch_text(vk_t* vk, float x, float y, unsigned scale,
+    const char* text, const struct vk_color* color);
+
+struct vk_texture vulkan_create_glyph_atlas(vk_t* vk);
+
 static unsigned vulkan_format_to_bpp(VkFormat format)
 {
     switch (format)
@@ -705,6 +875,24 @@ extern "C" {
         VkDevice device,
         struct vk_buffer_chain* chain);
 
+    bool vulkan_buffer_ring_init(const struct vulkan_context* context,
+        struct vk_buffer_ring* ring, VkDeviceSize size,
+        VkDeviceSize alignment, VkBufferUsageFlags usage);
+
+    /* Must be called once per frame, after the fence for
+     * frame_index has been waited on. */
+    void vulkan_buffer_ring_begin_frame(struct vk_buffer_ring* ring,
+        unsigned frame_index);
+
+    /* Allocates from the ring, falling back to the overflow chain
+     * when the frames in flight have used the whole ring. */
+    bool vulkan_buffer_ring_alloc(const struct vulkan_context* context,
+        struct vk_buffer_ring* ring, struct vk_buffer_chain* overflow,
+        size_t size, struct vk_buffer_range* range);
+
+    void vulkan_buffer_ring_free(VkDevice device,
+        struct vk_buffer_ring* ring, const char* name);
+
     uint32_t vulkan_find_memory_type(
         const VkPhysicalDeviceMemoryProperties* mem_props,
         uint32_t device_reqs, uint32_t host_reqs);
@@ -735,10 +923,24 @@ extern "C" {
         VkDevice device,
         struct vk_buffer* buffer);
 
+    /* Device local memory in use and available to the process, from
+     * VK_EXT_memory_budget when supported. Otherwise only what the
+     * allocator holds is known and *budget is 0. */
+    void vulkan_get_vram_usage(const struct vulkan_context* context,
+        uint64_t* used, uint64_t* budget);
+
     VkDescriptorSet vulkan_descriptor_manager_alloc(
         VkDevice device,
         struct vk_descriptor_manager* manager);
 
+    /* Returns a set holding the given quad bindings, reusing one written
+     * earlier in the same frame when the bindings are identical. */
+    VkDescriptorSet vulkan_descriptor_manager_get_quad_set(
+        VkDevice device,
+        struct vk_descriptor_manager* manager,
+        const VkDescriptorUpdateTemplate* templates,
+        const struct vk_quad_descriptor_data* data);
+
     struct vk_descriptor_manager vulkan_create_descriptor_manager(
         VkDevice device,
         const VkDescriptorPoolSize* sizes, unsigned num_sizes,
@@ -762,6 +964,12 @@ extern "C" {
 
     void vulkan_present(gfx_ctx_vulkan_data_t* vk, unsigned index);
 
+    void vulkan_queue_lock(vulkan_context_t* context, enum vulkan_queue_holder holder);
+
+    void vulkan_queue_unlock(vulkan_context_t* context, enum vulkan_queue_holder holder);
+
+    void vulkan_log_queue_holds(vulkan_context_t* context);
+
     void vulkan_acquire_next_image(gfx_ctx_vulkan_data_t* vk);
 
     bool vulkan_create_swapchain(gfx_ctx_vulkan_data_t* vk,
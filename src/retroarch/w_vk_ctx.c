@@ -174,7 +174,13 @@ static void gfx_ctx_w_vk_destroy(void* data)
 
     vulkan_context_destroy(&win32_vk, win32_vk.vk_surface != VK_NULL_HANDLE);
     if (win32_vk.context.queue_lock)
+    {
+        unsigned spun, slept;
+        slock_get_contention(win32_vk.context.queue_lock, &spun, &slept);
+        RARCH_LOG("[Vulkan]: Queue lock contended %u times, %u of them slept.\n", spun + slept, slept);
+        vulkan_log_queue_holds(&win32_vk.context);
         slock_free(win32_vk.context.queue_lock);
+    }
     memset(&win32_vk, 0, sizeof(win32_vk));
 
     if (window)
@@ -0,0 +1,96 @@
+#include "scale_governor.h"
+
+// Fraction of the frame budget the RDP may use before stepping down,
+// and the fraction it has to stay under before trying the next level.
+static const double kHighWatermark = 0.85;
+static const double kLowWatermark = 0.30;
+
+static const unsigned kFramesToStepDown = 30;
+static const unsigned kFramesToStepUp = 600;
+static const unsigned kCooldownFrames = 180;
+// A step up undone within this many frames counts as a misprediction.
+static const unsigned kRevertWindow = 600;
+static const unsigned kMaxBackoff = 8;
+
+static const double kAverageWeight = 0.1;
+
+void ScaleGovernor::reset(unsigned upscaling, unsigned downscaling_steps, double frame_budget_ms) {
+    configured_ = {upscaling ? upscaling : 1, downscaling_steps};
+    num_levels_ = 1;
+    for (unsigned u = configured_.upscaling; u > 1; u >>= 1)
+        num_levels_++;
+
+    index_ = 0;
+    budget_ms_ = frame_budget_ms;
+    average_ms_ = 0.0;
+    has_average_ = false;
+    frames_over_ = 0;
+    frames_under_ = 0;
+    cooldown_ = kCooldownFrames;
+    frames_since_up_ = 0;
+    up_backoff_ = 1;
+    stepped_up_ = false;
+}
+
+void ScaleGovernor::start_at(unsigned upscaling) {
+    while (index_ + 1 < num_levels_ && level_at(index_).upscaling > upscaling)
+        index_++;
+}
+
+ScaleGovernor::Level ScaleGovernor::level_at(unsigned index) const {
+    Level level;
+    level.upscaling = configured_.upscaling >> index;
+    level.downscaling_steps = configured_.downscaling_steps > index ? configured_.downscaling_steps - index : 0;
+    return level;
+}
+
+ScaleGovernor::Level ScaleGovernor::level() const {
+    return level_at(index_);
+}
+
+bool ScaleGovernor::add_sample(double gpu_ms) {
+    if (!has_average_) {
+        average_ms_ = gpu_ms;
+        has_average_ = true;
+    } else {
+        average_ms_ += (gpu_ms - average_ms_) * kAverageWeight;
+    }
+
+    if (stepped_up_)
+        frames_since_up_++;
+
+    if (cooldown_) {
+        cooldown_--;
+        return false;
+    }
+
+    if (average_ms_ > budget_ms_ * kHighWatermark) {
+        frames_under_ = 0;
+        if (++frames_over_ < kFramesToStepDown || index_ + 1 >= num_levels_)
+            return false;
+
+        if (stepped_up_ && frames_since_up_ < kRevertWindow && up_backoff_ < kMaxBackoff)
+            up_backoff_ *= 2;
+        stepped_up_ = false;
+        index_++;
+    } else if (average_ms_ < budget_ms_ * kLowWatermark) {
+        frames_over_ = 0;
+        if (++frames_under_ < kFramesToStepUp * up_backoff_ || index_ == 0)
+            return false;
+
+        stepped_up_ = true;
+        frames_since_up_ = 0;
+        index_--;
+    } else {
+        frames_over_ = 0;
+        frames_under_ = 0;
+        return false;
+    }
+
+    frames_over_ = 0;
+    frames_under_ = 0;
+    cooldown_ = kCooldownFrames;
+    // The new level starts from a clean average.
+    has_average_ = false;
+    return true;
+}
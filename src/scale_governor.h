@@ -0,0 +1,50 @@
+#pragma once
+
+// Picks the RDP upscale factor and VI downscale steps from measured GPU
+// frame times. Levels run from the configured setting down to native:
+// every level halves the upscale factor and drops one downscale step, so
+// the final output resolution stays roughly where the user put it.
+//
+// Stepping down needs a short run of frames over budget, stepping back up
+// a much longer run well under it. A step up which gets reverted soon
+// after makes the next attempt wait longer.
+class ScaleGovernor {
+  public:
+    struct Level {
+        unsigned upscaling;
+        unsigned downscaling_steps;
+    };
+
+    void reset(unsigned upscaling, unsigned downscaling_steps, double frame_budget_ms);
+    // Starts from the first level at or below the given upscale factor,
+    // e.g. one a previous session settled on.
+    void start_at(unsigned upscaling);
+
+    // Feeds one frame worth of RDP GPU time. Returns true when the
+    // level changed and the frontend has to be recreated.
+    bool add_sample(double gpu_ms);
+
+    Level level() const;
+    Level configured() const { return configured_; }
+    double average_ms() const { return average_ms_; }
+    unsigned index() const { return index_; }
+
+  private:
+    Level level_at(unsigned index) const;
+
+    Level configured_ = {1, 0};
+    unsigned num_levels_ = 1;
+    // 0 is the configured level, larger is cheaper.
+    unsigned index_ = 0;
+
+    double budget_ms_ = 1000.0 / 60.0;
+    double average_ms_ = 0.0;
+    bool has_average_ = false;
+
+    unsigned frames_over_ = 0;
+    unsigned frames_under_ = 0;
+    unsigned cooldown_ = 0;
+    unsigned frames_since_up_ = 0;
+    unsigned up_backoff_ = 1;
+    bool stepped_up_ = false;
+};
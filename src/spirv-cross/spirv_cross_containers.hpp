@@ -40,6 +40,169 @@
 
 namespace SPIRV_CROSS_NAMESPACE
 {
+// Bump allocator for the heap storage of SmallVector and ObjectPool.
+// While an ArenaScope is active on a thread, those allocations are carved
+// out of the arena and freeing them only rewinds the most recent one.
+// Everything allocated inside the scope must be destroyed before it ends,
+// the arena then hands all of it back in one go.
+class Arena
+{
+public:
+	struct Stats
+	{
+		size_t allocations = 0;
+		size_t bytes = 0;
+		size_t blocks = 0;
+	};
+
+	explicit Arena(size_t block_size_ = 64 * 1024)
+	    : block_size(block_size_)
+	{
+	}
+
+	~Arena()
+	{
+		reset();
+	}
+
+	Arena(const Arena &) = delete;
+	void operator=(const Arena &) = delete;
+
+	void *allocate(size_t size)
+	{
+		size = (size + Alignment - 1) & ~size_t(Alignment - 1);
+		if (!head || head->size - offset < size)
+		{
+			size_t new_size = size > block_size ? size : block_size;
+			auto *block = static_cast<Block *>(malloc(sizeof(Block) + new_size));
+			if (!block)
+				return nullptr;
+			block->next = head;
+			block->size = new_size;
+			head = block;
+			offset = 0;
+			stats.blocks++;
+		}
+
+		last = head->data() + offset;
+		offset += size;
+		stats.allocations++;
+		stats.bytes += size;
+		return last;
+	}
+
+	bool owns(const void *ptr) const
+	{
+		auto *p = static_cast<const char *>(ptr);
+		for (const Block *block = head; block; block = block->next)
+			if (p >= block->data() && p < block->data() + block->size)
+				return true;
+		return false;
+	}
+
+	void release(void *ptr)
+	{
+		// Growing vectors free their previous buffer right after
+		// allocating the next one, so only the top can be reclaimed.
+		if (ptr == last)
+		{
+			offset = size_t(static_cast<char *>(ptr) - head->data());
+			last = nullptr;
+		}
+	}
+
+	void reset()
+	{
+		while (head)
+		{
+			Block *next = head->next;
+			::free(head);
+			head = next;
+		}
+		offset = 0;
+		last = nullptr;
+	}
+
+	const Stats &get_stats() const
+	{
+		return stats;
+	}
+
+private:
+	enum
+	{
+		Alignment = 16
+	};
+
+	struct Block
+	{
+		Block *next;
+		size_t size;
+		alignas(Alignment) char padding[1];
+
+		char *data()
+		{
+			return padding;
+		}
+
+		const char *data() const
+		{
+			return padding;
+		}
+	};
+
+	Block *head = nullptr;
+	char *last = nullptr;
+	size_t offset = 0;
+	size_t block_size;
+	Stats stats;
+};
+
+inline Arena *&current_arena()
+{
+	static thread_local Arena *arena = nullptr;
+	return arena;
+}
+
+class ArenaScope
+{
+public:
+	explicit ArenaScope(Arena &arena)
+	    : previous(current_arena())
+	{
+		current_arena() = &arena;
+	}
+
+	~ArenaScope()
+	{
+		current_arena() = previous;
+	}
+
+	ArenaScope(const ArenaScope &) = delete;
+	void operator=(const ArenaScope &) = delete;
+
+private:
+	Arena *previous;
+};
+
+inline void *arena_malloc(size_t size)
+{
+	Arena *arena = current_arena();
+	return arena ? arena->allocate(size) : malloc(size);
+}
+
+inline void arena_free(void *ptr)
+{
+	if (!ptr)
+		return;
+
+	Arena *arena = current_arena();
+	if (arena && arena->owns(ptr))
+		arena->release(ptr);
+	else
+		::free(ptr);
+}
+
 #ifndef SPIRV_CROSS_FORCE_STL_TYPES
 // std::aligned_storage does not support size == 0, so roll our own.
 template <typename T, size_t N>
@@ -222,7 +385,7 @@ public:
 		{
 			// Pilfer allocated pointer.
 			if (this->ptr != stack_storage.data())
-				free(this->ptr);
+				arena_free(this->ptr);
 			this->ptr = other.ptr;
 			this->buffer_size = other.buffer_size;
 			buffer_capacity = other.buffer_capacity;
@@ -271,7 +434,7 @@ public:
 	{
 		clear();
 		if (this->ptr != stack_storage.data())
-			free(this->ptr);
+			arena_free(this->ptr);
 	}
 
 	void clear()
@@ -325,7 +488,7 @@ public:
 				target_capacity <<= 1u;
 
 			T *new_buffer =
-			    target_capacity > N ? static_cast<T *>(malloc(target_capacity * sizeof(T))) : stack_storage.data();
+			    target_capacity > N ? static_cast<T *>(arena_malloc(target_capacity * sizeof(T))) : stack_storage.data();
 
 			if (!new_buffer)
 				SPIRV_CROSS_THROW("Out of memory.");
@@ -342,7 +505,7 @@ public:
 			}
 
 			if (this->ptr != stack_storage.data())
-				free(this->ptr);
+				arena_free(this->ptr);
 			this->ptr = new_buffer;
 			buffer_capacity = target_capacity;
 		}
@@ -373,7 +536,7 @@ public:
 
 				// Need to allocate new buffer. Move everything to a new buffer.
 				T *new_buffer =
-				    target_capacity > N ? static_cast<T *>(malloc(target_capacity * sizeof(T))) : stack_storage.data();
+				    target_capacity > N ? static_cast<T *>(arena_malloc(target_capacity * sizeof(T))) : stack_storage.data();
 				if (!new_buffer)
 					SPIRV_CROSS_THROW("Out of memory.");
 
@@ -410,7 +573,7 @@ public:
 				}
 
 				if (this->ptr != stack_storage.data())
-					free(this->ptr);
+					arena_free(this->ptr);
 				this->ptr = new_buffer;
 				buffer_capacity = target_capacity;
 			}
@@ -537,7 +700,7 @@ public:
 		if (vacants.empty())
 		{
 			unsigned num_objects = start_object_count << memory.size();
-			T *ptr = static_cast<T *>(malloc(num_objects * sizeof(T)));
+			T *ptr = static_cast<T *>(arena_malloc(num_objects * sizeof(T)));
 			if (!ptr)
 				return nullptr;
 
@@ -577,7 +740,7 @@ protected:
 	{
 		void operator()(T *ptr)
 		{
-			::free(ptr);
+			arena_free(ptr);
 		}
 	};
 